@@ -17,7 +17,11 @@
 #include <string.h>
 #include <sys/types.h>
 
+#include "document.h"
+#include "filter.h"
+#include "history.h"
 #include "point.h"
+#include "tiles.h"
 #include "helper.h"
 
 #define unpack_color(color) (color.r), (color.g), (color.b), (color.a)
@@ -28,6 +32,12 @@
     #define SAVE_LOCATION "Pictures/"
 #endif
 
+#define DOCUMENT_PATH SAVE_LOCATION "drawing" DOCUMENT_EXTENSION
+
+#define RESIZE_DEBOUNCE_MS 50      // Quiet time after the last resize event before redrawing
+#define ERASOR_RADIUS 6.0f          // How far from a stroke the erasor still picks it up
+#define ERASOR_SIZE 20              // Side of the squares the erasor paints over with Shift held
+
 #define swap(a, b) \
     do { \
         typeof(*a) temp = *a; \
@@ -46,15 +56,11 @@ enum Mode: uint8_t {
 typedef struct {
         LinesArray lines;
         Pan pan;
+        InputFilter filter;     // Between pointer events and the live stroke
+        PenPredictor predictor; // Fed what the filter lets through
         enum Mode current_mode;
 } TotalData;
 
-typedef struct {
-        SDL_Texture **data;
-        size_t capacity;
-        size_t count;
-} TextureArray;
-
 
 // Global Variables:
 SDL_Cursor* arrowCursor;
@@ -71,17 +77,53 @@ void handle_cursor_change(enum Mode current_mode) {
         }
 }
 
-void pushTexture(TextureArray *arr, SDL_Texture *tex) {
-        if (arr->count >= arr->capacity) {
-                arr->capacity *= 2;
-                arr->data = realloc(arr->data, arr->capacity * sizeof(SDL_Texture *));
-                if (!arr->data) {
-                perror("realloc failed");
-                exit(1);
+// Hides the topmost stroke under world point (x, y), records it for undo and marks its tiles.
+// Returns whether a stroke was erased.
+bool EraseStrokeAt(LinesArray *lines, History *history, TileGrid *tiles, float x, float y, Pan pan) {
+        int stroke = StrokeAt(lines, x, y, ERASOR_RADIUS);
+        if (stroke < 0) {
+                return false;
+        }
+
+        lines->strokes[stroke].flags |= STROKE_HIDDEN;
+        if (PushHistory(history, lines, HISTORY_REMOVE_STROKE, (uint32_t) stroke) != 0) {
+                fprintf(stderr, "Erasing can't be undone\n");
+        }
+        MarkTilesDirty(tiles, StrokeScreenBounds(lines, (uint32_t) stroke, pan));
+        return true;
+}
+
+// Paints erasor squares of `color` into paint op `op` along the world segment (x0, y0) to
+// (x1, y1), close enough to leave no gaps, and marks their tiles
+void EraseRectsAlong(LinesArray *lines, TileGrid *tiles, uint32_t op, float x0, float y0, float x1, float y1, SDL_Color color, Pan pan) {
+        float step = ERASOR_SIZE / 2.0f;
+        int dabs = (int) ceilf(hypotf(x1 - x0, y1 - y0) / step);
+        SDL_Rect dirty = {0};
+
+        for (int i = (dabs == 0) ? 0 : 1; i <= dabs; i++) {
+                float t = (dabs == 0) ? 1.0f : (float) i / dabs;
+                SDL_Rect dab = {
+                        .x = (int) floorf(x0 + (x1 - x0) * t - ERASOR_SIZE / 2.0f),
+                        .y = (int) floorf(y0 + (y1 - y0) * t - ERASOR_SIZE / 2.0f),
+                        .w = ERASOR_SIZE,
+                        .h = ERASOR_SIZE,
+                };
+                if (PaintRect(&lines->paint, op, dab, color) != 0) {
+                        break;
+                }
+
+                if (dirty.w == 0) {
+                        dirty = dab;
+                } else {
+                        SDL_UnionRect(&dirty, &dab, &dirty);
                 }
         }
-        arr->data[arr->count] = tex;
-        arr->count++;
+
+        if (dirty.w != 0) {
+                dirty.x += (int) floor(pan.x);
+                dirty.y += (int) floor(pan.y);
+                MarkTilesDirty(tiles, dirty);
+        }
 }
 
 int main(void) {
@@ -128,40 +170,60 @@ int main(void) {
 
         TotalData Data = {
                 .lines = {
-                        .points = NULL,
-                        .pointCount = 0,
-                        .pointCapacity = 0,
+                        .points = {0},
+                        .strokes = NULL,
+                },
+                .filter = {
+                        .config = FILTER_DEFAULTS,
+                        .enabled = true,
                 },
                 .current_mode = MODE_NONE,
                 .pan.x = 0,
                 .pan.y = 0,
         };
 
+        // Window sized textures come back around as the window is resized
+        TexturePool texturePool;
+        InitTexturePool(&texturePool, renderer, TEXTURE_POOL_CAP);
+
         // This is where all of lines are drawn
-        TextureArray drawLayers = {
-                .data = malloc(2 * sizeof(SDL_Texture *)),
-                .capacity = 2,
-                .count = 0
-        };
+        SDL_Texture *drawLayer = AcquireTexture(&texturePool, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, window_width, window_height);
 
-        drawLayers.data[0] = SDL_CreateTexture(
-                renderer,
-                SDL_PIXELFORMAT_RGBA8888,
-                SDL_TEXTUREACCESS_TARGET,
-                window_width,
-                window_height
-        );
-        drawLayers.data[1] = SDL_CreateTexture(
-                renderer,
-                SDL_PIXELFORMAT_RGBA8888,
-                SDL_TEXTUREACCESS_TARGET,
-                window_width,
-                window_height
-        );
-        drawLayers.count += 2;
+        SDL_Rect layerRect = { 0, 0, window_width, window_height };    // Unscaled, even while a resize settles
+
+        // Undo and redo hide and show strokes; the layer is then fixed up from the strokes
+        History history = {0};
+
+        // PNG exports are encoded off this thread; without it they're written on the spot
+        ImageExporter exporter;
+        CreateImageExporter(&exporter);
 
-        size_t current_drawLayers_index = drawLayers.count - 1;
-        SDL_Texture *drawLayer = drawLayers.data[current_drawLayers_index];
+        // Strokes opened from a document read their points straight from its mapping
+        Document document = {0};
+
+        set_window_dimensions(window_width, window_height);
+        InitRasterKernels();
+        InitSimplifyKernels();
+
+        // Lines are rasterized on the CPU and uploaded once per frame instead of
+        // going through the renderer one pixel at a time. Toggle with 'r'.
+        RasterBuffer canvas;
+        TileGrid tiles = {0};
+        // Whether the canvas and tile grid fit the window; the CPU path can't be used without them
+        bool raster_available = CreateRasterBuffer(&canvas, renderer, window_width, window_height, &texturePool) == 0
+                && ResizeTileGrid(&tiles, window_width, window_height) == 0;
+        bool cpu_raster = raster_available;
+
+        // Full redraws are split by tile across one worker per spare core
+        WorkerPool workers;
+        if (CreateWorkerPool(&workers, SDL_GetCPUCount() - 1) == 0) {
+                tiles.pool = &workers;
+        }
+
+        // Whether canvas holds exactly the displayed document, rendered at canvas_pan.
+        // While it does, panning scrolls it and only fills the exposed strips.
+        bool canvas_in_sync = false;
+        Pan canvas_pan = {0};
 
         // Icons
         SDL_Rect toolLayerRect = {
@@ -206,12 +268,22 @@ int main(void) {
         Data.current_mode = MODE_DRAWING;
 
         SDL_Event event;
-        enum Mode current_mode;
-        uint16_t line_start_index;
+        enum Mode current_mode = MODE_NONE;    // The tool of the gesture in progress, MODE_NONE between them
         bool newLineAdded = false;
+        bool documentChanged = false;   // Strokes or paint were hidden, shown or painted; their tiles are marked dirty
+        uint32_t paint_op = 0;          // The erasor's paint op while it paints squares
+        bool erasing_rects = false;
+        float erase_x = 0, erase_y = 0; // Last world point the erasor painted at
+        float frame_ms = 16.0f;         // Recent frame time, how far ahead the live stroke is predicted
+        #ifdef DEBUG
+                uint32_t draw_calls = 0, draw_frames = 0, draw_report = SDL_GetTicks();
+        #endif
+        bool resize_pending = false;
+        uint32_t resize_time = 0;
 
         while (app_is_running) {
-                drawLayer = drawLayers.data[current_drawLayers_index];
+                uint32_t frame_start = SDL_GetTicks();
+                ResetDrawCallCount();
 
                 handle_cursor_change(Data.current_mode);
                 while (SDL_PollEvent(&event)) {
@@ -219,21 +291,9 @@ int main(void) {
                                 case SDL_QUIT: app_is_running = false; break;
                                 case SDL_WINDOWEVENT:
                                         if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-                                                SDL_GetWindowSize(window, &window_width, &window_height);
-                                                set_window_dimensions(window_width, window_height);
-                                                SDL_Texture* old = drawLayer;
-
-                                                drawLayer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, window_width, window_height);
-                                                SDL_SetTextureBlendMode(drawLayer, SDL_BLENDMODE_BLEND);
-
-                                                // Copy content from old layer to new one, and destroy previous one
-                                                SDL_SetRenderTarget(renderer, drawLayer);
-                                                SDL_RenderCopy(renderer, old, NULL, NULL);
-                                                SDL_SetRenderTarget(renderer, NULL);
-                                                SDL_DestroyTexture(old);
-
-                                                // Other:
-                                                toolLayerRect.x = (window_width - toolLayerRect.w) >> 1;
+                                                // Dragging the window edge sends a stream of these: act once it settles
+                                                resize_pending = true;
+                                                resize_time = SDL_GetTicks();
                                         }
                                         break;
                                 case SDL_KEYDOWN:
@@ -244,29 +304,64 @@ int main(void) {
                                                 case SDLK_e: Data.current_mode = MODE_ERASOR; break;
                                                 case SDLK_t: Data.current_mode = MODE_TYPING; break;
                                                 case SDLK_d: Data.current_mode = MODE_DRAWING; break;
+                                                case SDLK_f: Data.filter.enabled = !Data.filter.enabled; break;
+                                                case SDLK_r:
+                                                        cpu_raster = !cpu_raster && raster_available;
+                                                        canvas_in_sync = false;
+                                                        rerender = true;
+                                                        break;
                                         }
 
                                         if (event.key.keysym.mod & KMOD_LCTRL) {
                                                 switch (event.key.keysym.sym) {
                                                         case SDLK_s:
-                                                                SaveRendererAsImage(renderer, "__image__", SAVE_LOCATION);
-                                                                break;
-                                                        case SDLK_z:
-                                                                // Undo
-                                                                if (current_drawLayers_index > 0) {
-                                                                        current_drawLayers_index--;
+                                                                if (event.key.keysym.mod & KMOD_SHIFT) {
+                                                                        SaveDocument(DOCUMENT_PATH, &Data.lines);
                                                                 } else {
-                                                                        current_drawLayers_index = 0;
+                                                                        SaveRendererAsImage(renderer, &exporter, "__image__", SAVE_LOCATION);
                                                                 }
                                                                 break;
-                                                        case SDLK_y:
-                                                                // Redo
-                                                                if (current_drawLayers_index + 1 >= drawLayers.count) {
-                                                                        current_drawLayers_index = drawLayers.count - 1;
-                                                                } else {
-                                                                        current_drawLayers_index++;
+                                                        case SDLK_o: {
+                                                                #ifdef DEBUG
+                                                                        Uint32 open_start = SDL_GetTicks();
+                                                                #endif
+                                                                LinesArray opened;
+                                                                Document opened_document;
+                                                                if (LoadDocument(DOCUMENT_PATH, &opened, &opened_document) != 0) {
+                                                                        break;
                                                                 }
+
+                                                                // History, and an erasor drag's paint op, refer to the old document by id
+                                                                FreeHistory(&history);
+                                                                erasing_rects = false;
+                                                                FreeLinesArray(&Data.lines);
+                                                                CloseDocument(&document);
+                                                                Data.lines = opened;
+                                                                document = opened_document;
+
+                                                                canvas_in_sync = false;
+                                                                rerender = true;
+
+                                                                #ifdef DEBUG
+                                                                        printf("[Document] Opened %u strokes in %u ms\n", Data.lines.strokeCount, SDL_GetTicks() - open_start);
+                                                                #endif
                                                                 break;
+                                                        }
+                                                        case SDLK_z: case SDLK_y: {
+                                                                HistoryOp op;
+                                                                int result = (event.key.keysym.sym == SDLK_z)
+                                                                        ? Undo(&history, &Data.lines, &op)
+                                                                        : Redo(&history, &Data.lines, &op);
+                                                                if (result != 0) {
+                                                                        break;
+                                                                }
+
+                                                                MarkTilesDirty(&tiles, (op.kind == HISTORY_RASTER)
+                                                                        ? PaintScreenBounds(&Data.lines, op.id, Data.pan)
+                                                                        : StrokeScreenBounds(&Data.lines, op.id, Data.pan));
+                                                                documentChanged = true;
+                                                                break;
+                                                        }
                                                 }
                                         }
                                         break;
@@ -289,8 +384,23 @@ int main(void) {
                                                         current_mode = Data.current_mode;
                                                         switch (current_mode) {
                                                                 case MODE_DRAWING:
-                                                                        addPoint(&Data.lines, (float) (event.button.x  - Data.pan.x), (float) (event.button.y  - Data.pan.y), LINE_THICKNESS, true);
-                                                                        line_start_index = Data.lines.pointCount - 1;
+                                                                        FilterBegin(&Data.filter, (float) (event.button.x  - Data.pan.x), (float) (event.button.y  - Data.pan.y), event.button.timestamp);
+                                                                        PredictBegin(&Data.predictor, (float) (event.button.x  - Data.pan.x), (float) (event.button.y  - Data.pan.y), event.button.timestamp);
+                                                                        StreamPoint(&Data.lines, (float) (event.button.x  - Data.pan.x), (float) (event.button.y  - Data.pan.y), LINE_THICKNESS, true);
+                                                                        break;
+                                                                case MODE_ERASOR:
+                                                                        erase_x = (float) (event.button.x  - Data.pan.x);
+                                                                        erase_y = (float) (event.button.y  - Data.pan.y);
+                                                                        // With Shift the erasor paints the background over whatever is there,
+                                                                        // kept as one paint op for the whole drag
+                                                                        erasing_rects = (SDL_GetModState() & KMOD_SHIFT)
+                                                                                && BeginPaintOp(&Data.lines.paint, Data.lines.strokeCount, Data.lines.points.count, &paint_op) == 0;
+                                                                        if (erasing_rects) {
+                                                                                EraseRectsAlong(&Data.lines, &tiles, paint_op, erase_x, erase_y, erase_x, erase_y, bg_color, Data.pan);
+                                                                                documentChanged = true;
+                                                                        } else if (EraseStrokeAt(&Data.lines, &history, &tiles, erase_x, erase_y, Data.pan)) {
+                                                                                documentChanged = true;
+                                                                        }
                                                                         break;
                                                                 default: break;
                                                         }
@@ -302,10 +412,22 @@ int main(void) {
                                                 case SDL_BUTTON_LEFT:
                                                         switch (current_mode) {
                                                                 case MODE_DRAWING: {
-                                                                        addPoint(&Data.lines, (float) (event.button.x  - Data.pan.x), (float) (event.button.y  - Data.pan.y), LINE_THICKNESS, false);
+                                                                        // Unfiltered, so the stroke ends where the pen was lifted
+                                                                        StreamPoint(&Data.lines, (float) (event.button.x  - Data.pan.x), (float) (event.button.y  - Data.pan.y), LINE_THICKNESS, false);
                                                                         newLineAdded = true;
+                                                                        #ifdef DEBUG
+                                                                                if (Data.filter.enabled) {
+                                                                                        printf("[Filter] Lag: %.1f ms, trailed by up to %.2f px\n", Data.filter.lag, Data.filter.max_trail);
+                                                                                }
+                                                                        #endif
                                                                         break;
                                                                 }
+                                                                case MODE_ERASOR:
+                                                                        if (erasing_rects && PushHistory(&history, &Data.lines, HISTORY_RASTER, paint_op) != 0) {
+                                                                                fprintf(stderr, "Erasing can't be undone\n");
+                                                                        }
+                                                                        erasing_rects = false;
+                                                                        break;
                                                                 default: break;
                                                         }
                                                         current_mode = MODE_NONE;
@@ -319,100 +441,220 @@ int main(void) {
                                                         PanPoints(&Data.pan, (double) (event.motion.xrel), (double) (event.motion.yrel));
                                                         rerender = true;
                                                         break;
-                                                case MODE_DRAWING:
-                                                        addPoint(&Data.lines, (float) (event.button.x  - Data.pan.x), (float) (event.button.y  - Data.pan.y), LINE_THICKNESS, true);
+                                                case MODE_DRAWING: {
+                                                        float x = (float) (event.motion.x - Data.pan.x), y = (float) (event.motion.y - Data.pan.y);
+                                                        if (FilterSample(&Data.filter, &x, &y, event.motion.timestamp)) {
+                                                                StreamPoint(&Data.lines, x, y, LINE_THICKNESS, true);
+                                                                PredictSample(&Data.predictor, x, y, event.motion.timestamp);
+                                                        }
+                                                        break;
+                                                }
+                                                case MODE_ERASOR: {
+                                                        float x = (float) (event.motion.x - Data.pan.x), y = (float) (event.motion.y - Data.pan.y);
+                                                        if (erasing_rects) {
+                                                                EraseRectsAlong(&Data.lines, &tiles, paint_op, erase_x, erase_y, x, y, bg_color, Data.pan);
+                                                                erase_x = x;
+                                                                erase_y = y;
+                                                                documentChanged = true;
+                                                        } else if (EraseStrokeAt(&Data.lines, &history, &tiles, x, y, Data.pan)) {
+                                                                documentChanged = true;
+                                                        }
                                                         break;
+                                                }
                                                 default: break;
                                         }
                                         break;
                         }
                 }
 
+                // Exports finished since the last frame
+                ExportStatus export_status;
+                while (PollExport(&exporter, &export_status)) {
+                        if (export_status.ok) {
+                                printf("Saved %s\n", export_status.file_name);
+                        } else {
+                                printf("Unable to save image\n");
+                        }
+                        free(export_status.file_name);
+                }
+
+                if (resize_pending && SDL_GetTicks() - resize_time >= RESIZE_DEBOUNCE_MS) {
+                        resize_pending = false;
+                        int old_width = window_width, old_height = window_height;
+                        SDL_GetWindowSize(window, &window_width, &window_height);
+                        set_window_dimensions(window_width, window_height);
+
+                        SDL_Texture *layer = AcquireTexture(&texturePool, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, window_width, window_height);
+                        if (layer) {
+                                ReleaseTexture(&texturePool, drawLayer);
+                                drawLayer = layer;
+                                layerRect = (SDL_Rect) { 0, 0, window_width, window_height };
+                        }
+
+                        bool kept = cpu_raster && canvas_in_sync;
+                        raster_available = ResizeRasterBuffer(&canvas, renderer, window_width, window_height) == 0
+                                && ResizeTileGrid(&tiles, window_width, window_height) == 0;
+                        if (!raster_available) {
+                                cpu_raster = false;
+                        }
+
+                        if (cpu_raster && kept) {
+                                // The canvas kept what both sizes show; only the exposed tiles are
+                                // rasterized, from the strokes, then the kept part is copied over
+                                SDL_Rect shared = { 0, 0, SDL_min(old_width, window_width), SDL_min(old_height, window_height) };
+
+                                SDL_SetRenderTarget(renderer, drawLayer);
+                                SDL_SetTextureBlendMode(canvas.texture, SDL_BLENDMODE_NONE);
+                                RedrawDirtyTiles(&tiles, &canvas, renderer, &Data.lines, 0, Data.lines.points.count - 1, Data.pan, bg_color, draw_color);
+                                UploadRasterRect(&canvas, shared);
+                                SDL_RenderCopy(renderer, canvas.texture, &shared, &shared);
+                                SDL_SetRenderTarget(renderer, NULL);
+                        } else {
+                                canvas_in_sync = false;
+                                rerender = true;
+                        }
+
+                        toolLayerRect.x = (window_width - toolLayerRect.w) >> 1;
+
+                        #ifdef DEBUG
+                                printf("[Textures] Hits: %u, misses: %u, evictions: %u, idle: %zu KB\n",
+                                        texturePool.hits, texturePool.misses, texturePool.evictions, texturePool.idleBytes >> 10);
+                        #endif
+                }
+
+                // Erased, undone or redone strokes and paint
+                if (documentChanged) {
+                        if (cpu_raster && canvas_in_sync && !rerender) {
+                                // Only the tiles under them change
+                                SDL_SetRenderTarget(renderer, drawLayer);
+                                SDL_SetTextureBlendMode(canvas.texture, SDL_BLENDMODE_NONE);
+                                RedrawDirtyTiles(&tiles, &canvas, renderer, &Data.lines, 0, Data.lines.points.count - 1, Data.pan, bg_color, draw_color);
+                                SDL_SetRenderTarget(renderer, NULL);
+                        } else {
+                                // Also when a pan is pending: the canvas isn't at Data.pan to patch
+                                canvas_in_sync = false;
+                                rerender = true;
+                        }
+                        documentChanged = false;
+                }
+
                 if (rerender) {
                         SDL_SetRenderTarget(renderer, drawLayer);
 
-                        SDL_SetRenderDrawColor(renderer, unpack_color(bg_color));
-                        SDL_RenderClear(renderer);
+                        if (cpu_raster) {
+                                SDL_SetTextureBlendMode(canvas.texture, SDL_BLENDMODE_NONE);
+                                if (canvas_in_sync && ScrollAndFill(&canvas, renderer, &Data.lines, canvas_pan, Data.pan, bg_color, draw_color) == 0) {
+                                        UploadRasterBuffer(&canvas);
+                                        SDL_RenderCopy(renderer, canvas.texture, NULL, NULL);
+                                } else {
+                                        MarkAllTilesDirty(&tiles);
+                                        RedrawDirtyTiles(&tiles, &canvas, renderer, &Data.lines, 0, Data.lines.points.count - 1, Data.pan, bg_color, draw_color);
+                                }
+                                canvas_pan = Data.pan;
+                                canvas_in_sync = true;
+                        } else {
+                                SDL_SetRenderDrawColor(renderer, unpack_color(bg_color));
+                                SDL_RenderClear(renderer);
 
-                        ReRenderLines(renderer, &Data.lines, Data.pan, draw_color);
+                                ReRenderLines(renderer, &Data.lines, Data.pan, draw_color);
+                        }
                         SDL_SetRenderTarget(renderer, NULL);
                         rerender = false;
                 }
 
-                // If new line ended, save for future undo/redo action
+                // If new line ended, commit it and record it for undo
                 if (newLineAdded) {
-                        // Blueprint IG:
-                        // 1. Copy all previous strokes from drawLayer to newLayer
-                        // 2. Render new strokes to new layer
-                        // 3. Save new layer as drawLayer
-
-                        OptimizeLine(&Data.lines, line_start_index, Data.lines.pointCount - 1);
-                        SDL_Texture *newLayer = SDL_CreateTexture(
-                                renderer,
-                                SDL_PIXELFORMAT_RGBA8888,
-                                SDL_TEXTUREACCESS_TARGET,
-                                window_width,
-                                window_height
-                        );
-                        if (!newLayer) {
-                                fprintf(stdout, "Failed to create texture: %s\n", SDL_GetError());
-                                break;
+                        OptimizeLine(&Data.lines, LiveStrokeStart(&Data.lines), Data.lines.points.count - 1);
+                        if (CommitStroke(&Data.lines, draw_color) != 0) {
+                                // Nothing would own its points: drop it, the frame goes on
+                                fprintf(stderr, "Stroke can't be stored, dropping it\n");
+                                DiscardLiveStroke(&Data.lines);
+                                newLineAdded = false;
+                        }
+                }
+                if (newLineAdded) {
+                        uint32_t stroke_id = Data.lines.strokeCount - 1;
+                        uint32_t stroke_start = Data.lines.strokes[stroke_id].first_point;
+                        if (PushHistory(&history, &Data.lines, HISTORY_ADD_STROKE, stroke_id) != 0) {
+                                fprintf(stderr, "Stroke can't be undone\n");
                         }
 
-                        SDL_SetRenderTarget(renderer, newLayer);
-                        SDL_RenderCopy(renderer, drawLayers.data[current_drawLayers_index], NULL, NULL);
-
-                        __RenderLines__(renderer, &Data.lines, Data.pan, line_start_index, Data.lines.pointCount - 1, draw_color);
+                        SDL_SetRenderTarget(renderer, drawLayer);
 
-                        if (current_drawLayers_index < drawLayers.count - 1) {
-                                // Delete all texture after that index:
-                                for (size_t i = current_drawLayers_index + 1; i < drawLayers.count; i++) {
-                                        if (drawLayers.data[i]) {
-                                                SDL_DestroyTexture(drawLayers.data[i]);
-                                        }
-                                }
-                                drawLayers.count = current_drawLayers_index + 1;
+                        if (cpu_raster && canvas_in_sync) {
+                                // Only the tiles the new stroke touches are re-rasterized and copied over
+                                MarkTilesDirty(&tiles, StrokeScreenBounds(&Data.lines, stroke_id, Data.pan));
+                                SDL_SetTextureBlendMode(canvas.texture, SDL_BLENDMODE_NONE);
+                                RedrawDirtyTiles(&tiles, &canvas, renderer, &Data.lines, 0, Data.lines.points.count - 1, Data.pan, bg_color, draw_color);
+                        } else if (cpu_raster) {
+                                // Canvas doesn't match the layer (e.g. after toggling it): rasterize just the new
+                                // stroke into transparent tiles and blend it on top
+                                MarkTilesDirty(&tiles, StrokeScreenBounds(&Data.lines, stroke_id, Data.pan));
+                                SDL_SetTextureBlendMode(canvas.texture, SDL_BLENDMODE_BLEND);
+                                RedrawDirtyTiles(&tiles, &canvas, renderer, &Data.lines, stroke_start, Data.lines.points.count - 1, Data.pan, (SDL_Color) { 0, 0, 0, 0 }, draw_color);
+                        } else {
+                                RenderVisibleLines(renderer, &Data.lines, Data.pan, stroke_start, Data.lines.points.count - 1, draw_color);
                         }
 
                         SDL_SetRenderTarget(renderer, NULL);
-                        // Save newTexture:
-                        pushTexture(&drawLayers, newLayer);
-                        current_drawLayers_index = drawLayers.count - 1;
                         newLineAdded = false;
                 }
 
                 // Copy DrawLayers's content to renderer
-                SDL_RenderCopy(renderer, drawLayer, NULL, NULL);
+                SDL_SetRenderDrawColor(renderer, unpack_color(bg_color));
+                SDL_RenderClear(renderer);
+                SDL_RenderCopy(renderer, drawLayer, NULL, &layerRect);
 
                 // Tools:
                 SDL_RenderCopy(renderer, ToolsLayer, NULL, &toolLayerRect);
 
                 // New line provided by usr
-                RenderLine(renderer, &Data.lines, Data.pan, Data.lines.rendered_till, Data.lines.pointCount, (SDL_Color) { .r = 0, .g = 100, .b = 100, .a = 150 });
+                RenderLine(renderer, &Data.lines, Data.pan, Data.lines.rendered_till, Data.lines.points.count, (SDL_Color) { .r = 0, .g = 100, .b = 100, .a = 150 });
+
+                // Where the pen will be by the time this frame is on screen
+                float predicted_x, predicted_y;
+                if (Data.current_mode == MODE_DRAWING && PredictPosition(&Data.predictor, SDL_GetTicks(), frame_ms, &predicted_x, &predicted_y)) {
+                        RenderPrediction(renderer, &Data.lines, Data.pan, predicted_x, predicted_y, (SDL_Color) { .r = 0, .g = 100, .b = 100, .a = 75 });
+                }
 
                 SDL_RenderPresent(renderer);
 
                 #ifdef DEBUG
                         // print_live_usage();
+                        // Once a second, so it reads as a rate rather than scrolling by
+                        draw_calls += GetDrawCallCount();
+                        draw_frames++;
+                        if (SDL_GetTicks() - draw_report >= 1000) {
+                                printf("[Live] Draw calls: %.1f per frame over %u frames\n", (double) draw_calls / draw_frames, draw_frames);
+                                draw_calls = draw_frames = 0;
+                                draw_report = SDL_GetTicks();
+                        }
                         SDL_Delay(22); // ~45 FPS
                 #endif
-        }
 
-        if (Data.lines.points != NULL) {
-                free(Data.lines.points);
+                frame_ms += 0.125f * ((float) (SDL_GetTicks() - frame_start) - frame_ms);
         }
 
+        FreeHistory(&history);
+        FreeLinesArray(&Data.lines);
+        CloseDocument(&document);
+        FreeImageExporter(&exporter);
+
         SDL_FreeCursor(arrowCursor);
         SDL_FreeCursor(crosshairCursor);
         SDL_FreeCursor(panCursor);
         SDL_FreeCursor(erasorCursor);
 
-        for (size_t i = 0; i < drawLayers.count; i++) {
-                if (drawLayers.data[i]) {
-                        SDL_DestroyTexture(drawLayers.data[i]);
-                }
-        }
-        free(drawLayers.data);
+        ReleaseTexture(&texturePool, drawLayer);
+        FreeRasterBuffer(&canvas);
+        FreeTexturePool(&texturePool);
+        FreeTileGrid(&tiles);
+        FreeWorkerPool(&workers);
+        FreePointBatch();
+        FreeStrokeScratch();
+        FreeSimplifyScratch();
+        FreeFitScratch();
+        FreePaintScratch();
 
         SDL_DestroyTexture(penIcon);
         SDL_DestroyTexture(panIcon);
@@ -0,0 +1,88 @@
+#include "batch.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static PointBatch BATCH;
+static uint32_t DRAW_CALLS;
+
+static bool sameColor(SDL_Color a, SDL_Color b) {
+        return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+void BatchPoint(SDL_Renderer* renderer, float x, float y, SDL_Color color, float intensity) {
+        intensity = (intensity < 0.0f) ? 0.0f : (intensity > 1.0f) ? 1.0f : intensity;
+        uint8_t alpha = color.a * intensity;
+        uint8_t level = (alpha * (ALPHA_BUCKETS - 1) + 127) / 255;
+        if (level == 0) {
+                return;
+        }
+
+        if (BATCH.pending != 0 && !sameColor(BATCH.color, color)) {
+                FlushPointBatch(renderer);
+        }
+        BATCH.color = color;
+
+        PointBucket *bucket = &BATCH.buckets[level];
+        if (bucket->count >= bucket->capacity) {
+                uint32_t new_capacity = (bucket->capacity == 0) ? 256 : bucket->capacity << 1;
+
+                SDL_FPoint *temp = realloc(bucket->points, new_capacity * sizeof(SDL_FPoint));
+                if (!temp) {
+                        // Out of memory: draw what we have and reuse the bucket
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        FlushPointBatch(renderer);
+                        if (bucket->capacity == 0) {
+                                return;
+                        }
+                } else {
+                        bucket->points = temp;
+                        bucket->capacity = new_capacity;
+                }
+        }
+
+        bucket->points[bucket->count++] = (SDL_FPoint) { x, y };
+        BATCH.pending++;
+}
+
+void FlushPointBatch(SDL_Renderer* renderer) {
+        if (BATCH.pending == 0) {
+                return;
+        }
+
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        for (uint8_t level = 1; level < ALPHA_BUCKETS; level++) {
+                PointBucket *bucket = &BATCH.buckets[level];
+                if (bucket->count == 0) {
+                        continue;
+                }
+
+                uint8_t alpha = level * 255 / (ALPHA_BUCKETS - 1);
+                SDL_SetRenderDrawColor(renderer, BATCH.color.r, BATCH.color.g, BATCH.color.b, alpha);
+                SDL_RenderDrawPointsF(renderer, bucket->points, (int) bucket->count);
+                DRAW_CALLS++;
+
+                bucket->count = 0;
+        }
+        BATCH.pending = 0;
+}
+
+void FreePointBatch(void) {
+        for (uint8_t level = 0; level < ALPHA_BUCKETS; level++) {
+                free(BATCH.buckets[level].points);
+                BATCH.buckets[level] = (PointBucket) {0};
+        }
+        BATCH.pending = 0;
+}
+
+void CountDrawCalls(uint32_t calls) {
+        DRAW_CALLS += calls;
+}
+
+uint32_t GetDrawCallCount(void) {
+        return DRAW_CALLS;
+}
+
+void ResetDrawCallCount(void) {
+        DRAW_CALLS = 0;
+}
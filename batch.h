@@ -0,0 +1,31 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_render.h>
+#include <stdint.h>
+
+#pragma once
+
+// Per-pixel coverage is quantized into this many alpha levels; each level is
+// one SDL_RenderDrawPointsF call when the batch is flushed.
+#define ALPHA_BUCKETS 32
+
+typedef struct {
+        SDL_FPoint *points;
+        uint32_t count;
+        uint32_t capacity;
+} PointBucket;
+
+typedef struct {
+        PointBucket buckets[ALPHA_BUCKETS];
+        SDL_Color color;        // Color of every point in the batch, alpha ignored
+        uint32_t pending;       // Points across all buckets
+} PointBatch;
+
+void BatchPoint(SDL_Renderer* renderer, float x, float y, SDL_Color color, float intensity);
+void FlushPointBatch(SDL_Renderer* renderer);
+void FreePointBatch(void);
+
+// Renderer draw calls issued since the last reset (one per frame in App.c)
+void CountDrawCalls(uint32_t calls);
+uint32_t GetDrawCallCount(void);
+void ResetDrawCallCount(void);
@@ -0,0 +1,274 @@
+#include "document.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_VARINT_BYTES 5
+#define MAX_COORDINATE 1e9f     // Past this a stroke's bounds are damage, not drawing
+
+static uint32_t crcTable[256];
+
+static void initCrcTable(void) {
+        for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                crcTable[i] = c;
+        }
+}
+
+uint32_t DocumentChecksum(const void *data, size_t size) {
+        if (crcTable[1] == 0) {
+                initCrcTable();
+        }
+
+        const uint8_t *p = data;
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; i++) {
+                crc = crcTable[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+}
+
+bool CheckStrokeData(const Stroke *stroke) {
+        if (stroke->data_size == 0 || DocumentChecksum(stroke->data, stroke->data_size) != stroke->checksum) {
+                return false;
+        }
+
+        // Three varints a point, each ending on a byte without the high bit: with exactly that many
+        // ends and the last byte one of them, DecodePoints stays inside the block
+        uint64_t ends = 0;
+        uint32_t run = 0;
+        for (uint32_t i = 0; i < stroke->data_size; i++) {
+                if (stroke->data[i] & 0x80) {
+                        if (++run >= MAX_VARINT_BYTES) {
+                                return false;
+                        }
+                } else {
+                        ends++;
+                        run = 0;
+                }
+        }
+        return run == 0 && ends == 3 * (uint64_t) stroke->point_count;
+}
+
+static bool writeAll(FILE *file, const void *data, size_t size) {
+        return size == 0 || fwrite(data, size, 1, file) == 1;
+}
+
+int SaveDocument(const char *path, const LinesArray *PA) {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < PA->strokeCount; i++) {
+                count += !(PA->strokes[i].flags & STROKE_HIDDEN);
+        }
+
+        DocumentStroke *table = calloc(count ? count : 1, sizeof(DocumentStroke));
+        if (!table) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                return 1;
+        }
+
+        DocumentHeader header = {
+                .version = DOCUMENT_VERSION,
+                .header_size = sizeof(DocumentHeader),
+                .stroke_count = count,
+                .table_offset = sizeof(DocumentHeader),
+                .table_size = (uint64_t) count * sizeof(DocumentStroke),
+        };
+        memcpy(header.magic, DOCUMENT_MAGIC, sizeof(header.magic));
+        header.data_offset = header.table_offset + header.table_size;
+
+        for (uint32_t i = 0, j = 0; i < PA->strokeCount; i++) {
+                const Stroke *stroke = &PA->strokes[i];
+                if (stroke->flags & STROKE_HIDDEN) {
+                        continue;
+                }
+
+                // A mapped stroke that's been checked, or still isn't, keeps the checksum it came with
+                table[j++] = (DocumentStroke) {
+                        .bounds = stroke->bounds,
+                        .data_offset = header.data_size,
+                        .data_size = stroke->data_size,
+                        .point_count = stroke->point_count,
+                        .checksum = (stroke->flags & STROKE_MAPPED) ? stroke->checksum : DocumentChecksum(stroke->data, stroke->data_size),
+                        .color = stroke->color,
+                        .width = stroke->width,
+                };
+                header.data_size += stroke->data_size;
+                header.point_count += stroke->point_count;
+        }
+        header.table_checksum = DocumentChecksum(table, header.table_size);
+        header.header_checksum = DocumentChecksum(&header, offsetof(DocumentHeader, header_checksum));
+
+        size_t length = strlen(path);
+        char *temp_path = malloc(length + 5);
+        if (!temp_path) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                free(table);
+                return 1;
+        }
+        memcpy(temp_path, path, length);
+        memcpy(temp_path + length, ".tmp", 5);
+
+        FILE *file = fopen(temp_path, "wb");
+        bool ok = file != NULL
+                && writeAll(file, &header, sizeof(header))
+                && writeAll(file, table, header.table_size);
+        for (uint32_t i = 0; ok && i < PA->strokeCount; i++) {
+                const Stroke *stroke = &PA->strokes[i];
+                if (!(stroke->flags & STROKE_HIDDEN)) {
+                        ok = writeAll(file, stroke->data, stroke->data_size);
+                }
+        }
+        if (file && fclose(file) != 0) {
+                ok = false;
+        }
+
+        // The old file, which strokes may still be mapped from, stays whole until it's replaced
+        if (!ok || rename(temp_path, path) != 0) {
+                fprintf(stderr, "Unable to save document %s\n", path);
+                remove(temp_path);
+                ok = false;
+        }
+
+        free(temp_path);
+        free(table);
+        return ok ? 0 : 1;
+}
+
+static bool validBounds(Bounds b) {
+        return isfinite(b.x0) && isfinite(b.y0) && isfinite(b.x1) && isfinite(b.y1)
+                && b.x0 <= b.x1 && b.y0 <= b.y1
+                && fabsf(b.x0) < MAX_COORDINATE && fabsf(b.y0) < MAX_COORDINATE
+                && fabsf(b.x1) < MAX_COORDINATE && fabsf(b.y1) < MAX_COORDINATE;
+}
+
+// Checks the header and the stroke table, which is all that's read up front
+static bool validHeader(const uint8_t *map, size_t size) {
+        const DocumentHeader *header = (const DocumentHeader *) map;
+        if (size < sizeof(DocumentHeader) || memcmp(header->magic, DOCUMENT_MAGIC, sizeof(header->magic)) != 0) {
+                fprintf(stderr, "Not a document\n");
+                return false;
+        }
+        if (header->version != DOCUMENT_VERSION) {
+                fprintf(stderr, "Unsupported document version %u\n", header->version);
+                return false;
+        }
+        if (DocumentChecksum(header, offsetof(DocumentHeader, header_checksum)) != header->header_checksum) {
+                fprintf(stderr, "Document header is damaged\n");
+                return false;
+        }
+
+        if (header->header_size < sizeof(DocumentHeader) || header->table_offset < header->header_size
+            || header->table_offset % _Alignof(DocumentStroke) != 0
+            || header->table_size != (uint64_t) header->stroke_count * sizeof(DocumentStroke)
+            || header->table_offset > size || header->table_size > size - header->table_offset
+            || header->data_offset > size || header->data_size > size - header->data_offset) {
+                fprintf(stderr, "Document sections don't fit the file\n");
+                return false;
+        }
+        if (DocumentChecksum(map + header->table_offset, header->table_size) != header->table_checksum) {
+                fprintf(stderr, "Document stroke table is damaged\n");
+                return false;
+        }
+        return true;
+}
+
+int LoadDocument(const char *path, LinesArray *PA, Document *doc) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                fprintf(stderr, "Unable to open document %s\n", path);
+                return 1;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(DocumentHeader)) {
+                fprintf(stderr, "Not a document\n");
+                close(fd);
+                return 1;
+        }
+
+        size_t size = (size_t) info.st_size;
+        uint8_t *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+                fprintf(stderr, "Unable to map document %s\n", path);
+                return 1;
+        }
+
+        if (!validHeader(map, size)) {
+                munmap(map, size);
+                return 1;
+        }
+
+        const DocumentHeader *header = (const DocumentHeader *) map;
+        const DocumentStroke *table = (const DocumentStroke *) (map + header->table_offset);
+        uint8_t *data = map + header->data_offset;
+
+        LinesArray lines = {0};
+        lines.strokeCapacity = header->stroke_count ? header->stroke_count : 16;
+        lines.strokes = malloc(lines.strokeCapacity * sizeof(Stroke));
+        if (!lines.strokes) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                munmap(map, size);
+                return 1;
+        }
+
+        // One pass over the table; the point blocks it refers to aren't touched
+        uint32_t first_point = 0;
+        for (uint32_t i = 0; i < header->stroke_count; i++) {
+                const DocumentStroke *record = &table[i];
+                if (record->point_count == 0 || record->point_count > UINT32_MAX - first_point
+                    || record->data_size < 3 * (uint64_t) record->point_count
+                    || record->data_offset > header->data_size || record->data_size > header->data_size - record->data_offset
+                    || !validBounds(record->bounds)) {
+                        fprintf(stderr, "Document stroke %u is damaged\n", i);
+                        FreeLinesArray(&lines);
+                        munmap(map, size);
+                        return 1;
+                }
+
+                lines.strokes[lines.strokeCount] = (Stroke) {
+                        .bounds = record->bounds,
+                        .first_point = first_point,
+                        .point_count = record->point_count,
+                        .width = record->width,
+                        .flags = STROKE_MAPPED | STROKE_UNCHECKED,
+                        .color = record->color,
+                        .data = data + record->data_offset,
+                        .data_size = record->data_size,
+                        .checksum = record->checksum,
+                };
+                first_point += record->point_count;
+
+                if (SpatialInsert(&lines.index, lines.strokeCount++, record->bounds) != 0) {
+                        FreeLinesArray(&lines);
+                        munmap(map, size);
+                        return 1;
+                }
+        }
+
+        // New points are numbered after the document's
+        lines.unchecked = lines.strokeCount;
+        lines.points.first = lines.points.count = first_point;
+
+        *PA = lines;
+        *doc = (Document) { .map = map, .size = size };
+        return 0;
+}
+
+void CloseDocument(Document *doc) {
+        if (doc->map) {
+                munmap(doc->map, doc->size);
+        }
+        *doc = (Document) {0};
+}
+
+#undef MAX_VARINT_BYTES
+#undef MAX_COORDINATE
@@ -0,0 +1,67 @@
+#include <SDL2/SDL_pixels.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "point.h"
+
+#pragma once
+
+#define DOCUMENT_MAGIC "SCRATCH\x1A"
+#define DOCUMENT_VERSION 1
+#define DOCUMENT_EXTENSION ".scratch"
+
+// A .scratch file, in native (little-endian) byte order:
+//
+//      DocumentHeader          at 0
+//      DocumentStroke[]        stroke table, at table_offset
+//      point blocks            at data_offset: each stroke's EncodePoints data, back to back
+//
+// Everything is laid out to be used where it lies once the file is mapped: the stroke table is
+// read into the stroke array and the point blocks are never copied or parsed up front, strokes
+// point straight into them. Each section has its own checksum. The header and stroke table are
+// checked on open, each point block when its stroke is first about to be drawn.
+typedef struct {
+        char magic[8];          // DOCUMENT_MAGIC
+        uint32_t version;       // DOCUMENT_VERSION
+        uint32_t header_size;   // sizeof(DocumentHeader) when written
+        uint32_t stroke_count;
+        uint32_t point_count;   // Over every stroke
+        uint64_t table_offset, table_size;
+        uint64_t data_offset, data_size;
+        uint32_t table_checksum;
+        uint32_t header_checksum;       // Of the bytes before it
+} DocumentHeader;
+
+typedef struct {
+        Bounds bounds;
+        uint64_t data_offset;   // From the start of the point blocks
+        uint32_t data_size;
+        uint32_t point_count;
+        uint32_t checksum;      // Of the point block
+        SDL_Color color;
+        uint8_t width;
+        uint8_t reserved[7];
+} DocumentStroke;
+
+// The mapping a loaded document's strokes read their points from; it must outlive them
+typedef struct {
+        void *map;
+        size_t size;
+} Document;
+
+// CRC-32 (IEEE) of `size` bytes
+uint32_t DocumentChecksum(const void *data, size_t size);
+// True when the point block of a stroke loaded from a document matches its checksum and
+// decodes to exactly its point_count points without running past its end
+bool CheckStrokeData(const Stroke *stroke);
+
+// Writes the committed, visible strokes to `path` (through a temporary file, so a failed save
+// leaves the old one intact). The live stroke and paint ops aren't saved. Returns 1 on failure.
+int SaveDocument(const char *path, const LinesArray *PA);
+// Maps `path` and builds `*PA` over it, keeping the mapping in `*doc`. Returns 1 when the file
+// can't be read, isn't a document this version understands, or its header or stroke table are
+// damaged; *PA and *doc are then untouched.
+int LoadDocument(const char *path, LinesArray *PA, Document *doc);
+// Unmaps the document; free the LinesArray built over it first
+void CloseDocument(Document *doc);
@@ -0,0 +1,124 @@
+#include "export.h"
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "helper.h"
+
+static ExportStatus encodeJob(ExportJob job) {
+        ExportStatus status = { .file_name = unique_name((char *) job.location, (char *) job.prefix) };
+        if (status.file_name == NULL) {
+                printf("Error generating filename..\n");
+        } else if (IMG_SavePNG(job.surface, status.file_name) != 0) {
+                printf("Unable to save frame as PNG: %s\n", IMG_GetError());
+        } else {
+                status.ok = true;
+        }
+
+        SDL_FreeSurface(job.surface);
+        return status;
+}
+
+// Called with the lock held
+static void pushStatus(ImageExporter *exporter, ExportStatus status) {
+        exporter->done[(exporter->doneHead + exporter->doneCount++) % EXPORT_QUEUE_SIZE] = status;
+}
+
+static void* exporterMain(void *data) {
+        ImageExporter *exporter = data;
+
+        pthread_mutex_lock(&exporter->lock);
+        while (true) {
+                while (!exporter->quit && exporter->jobCount == 0) {
+                        pthread_cond_wait(&exporter->wake, &exporter->lock);
+                }
+                // Exports already asked for are still written on the way out
+                if (exporter->jobCount == 0) break;
+
+                ExportJob job = exporter->jobs[exporter->jobHead];
+                exporter->jobHead = (exporter->jobHead + 1) % EXPORT_QUEUE_SIZE;
+                exporter->jobCount--;
+
+                pthread_mutex_unlock(&exporter->lock);
+                ExportStatus status = encodeJob(job);
+                pthread_mutex_lock(&exporter->lock);
+
+                pushStatus(exporter, status);
+        }
+        pthread_mutex_unlock(&exporter->lock);
+
+        return NULL;
+}
+
+int CreateImageExporter(ImageExporter *exporter) {
+        *exporter = (ImageExporter) {0};
+        pthread_mutex_init(&exporter->lock, NULL);
+        pthread_cond_init(&exporter->wake, NULL);
+
+        if (pthread_create(&exporter->thread, NULL, exporterMain, exporter) != 0) {
+                fprintf(stderr, "Failed to create export thread\n");
+                return 1;
+        }
+        exporter->running = true;
+        return 0;
+}
+
+bool ExportQueueFull(ImageExporter *exporter) {
+        pthread_mutex_lock(&exporter->lock);
+        bool full = exporter->pending >= EXPORT_QUEUE_SIZE;
+        pthread_mutex_unlock(&exporter->lock);
+        return full;
+}
+
+int QueueExport(ImageExporter *exporter, ExportJob job) {
+        pthread_mutex_lock(&exporter->lock);
+        if (exporter->pending >= EXPORT_QUEUE_SIZE) {
+                pthread_mutex_unlock(&exporter->lock);
+                SDL_FreeSurface(job.surface);
+                return 1;
+        }
+        exporter->pending++;
+
+        if (!exporter->running) {
+                pthread_mutex_unlock(&exporter->lock);
+                ExportStatus status = encodeJob(job);
+                pthread_mutex_lock(&exporter->lock);
+                pushStatus(exporter, status);
+        } else {
+                exporter->jobs[(exporter->jobHead + exporter->jobCount++) % EXPORT_QUEUE_SIZE] = job;
+                pthread_cond_signal(&exporter->wake);
+        }
+        pthread_mutex_unlock(&exporter->lock);
+        return 0;
+}
+
+bool PollExport(ImageExporter *exporter, ExportStatus *status) {
+        pthread_mutex_lock(&exporter->lock);
+        bool found = exporter->doneCount > 0;
+        if (found) {
+                *status = exporter->done[exporter->doneHead];
+                exporter->doneHead = (exporter->doneHead + 1) % EXPORT_QUEUE_SIZE;
+                exporter->doneCount--;
+                exporter->pending--;
+        }
+        pthread_mutex_unlock(&exporter->lock);
+        return found;
+}
+
+void FreeImageExporter(ImageExporter *exporter) {
+        pthread_mutex_lock(&exporter->lock);
+        exporter->quit = true;
+        pthread_cond_signal(&exporter->wake);
+        pthread_mutex_unlock(&exporter->lock);
+
+        if (exporter->running) {
+                pthread_join(exporter->thread, NULL);
+        }
+
+        for (uint32_t i = 0; i < exporter->doneCount; i++) {
+                free(exporter->done[(exporter->doneHead + i) % EXPORT_QUEUE_SIZE].file_name);
+        }
+        pthread_mutex_destroy(&exporter->lock);
+        pthread_cond_destroy(&exporter->wake);
+        *exporter = (ImageExporter) {0};
+}
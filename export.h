@@ -0,0 +1,49 @@
+#include <SDL2/SDL.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+#define EXPORT_QUEUE_SIZE 4     // Exports waiting, encoding or unreported at once; more are turned away
+
+// A window read-back waiting to be written as a PNG
+typedef struct {
+        SDL_Surface *surface;   // Owned by the job
+        const char *location;   // Folder and file name prefix, must outlive the job
+        const char *prefix;
+} ExportJob;
+
+typedef struct {
+        bool ok;
+        char *file_name;        // malloc'd, NULL when no name could be made
+} ExportStatus;
+
+// One background thread that encodes and writes read-backs, so deflate never stalls a frame.
+// Jobs are done in order; each leaves a status for the UI thread to pick up with PollExport.
+typedef struct {
+        pthread_t thread;
+        bool running;           // Without the thread, jobs are done on the spot
+
+        pthread_mutex_t lock;
+        pthread_cond_t wake;    // New job or quit
+
+        ExportJob jobs[EXPORT_QUEUE_SIZE];
+        uint32_t jobHead, jobCount;
+        ExportStatus done[EXPORT_QUEUE_SIZE];
+        uint32_t doneHead, doneCount;
+        uint32_t pending;       // Queued, encoding or done but not yet polled
+        bool quit;
+} ImageExporter;
+
+int CreateImageExporter(ImageExporter *exporter);
+// True while another export would be turned away. Only the UI thread adds exports, so a
+// false answer holds until it queues one.
+bool ExportQueueFull(ImageExporter *exporter);
+// Hands `job` to the encoder. Returns 1 when the queue is full, and the job's surface is freed.
+int QueueExport(ImageExporter *exporter, ExportJob job);
+// Takes the oldest finished export's status; the caller frees status->file_name.
+// Returns false when none has finished.
+bool PollExport(ImageExporter *exporter, ExportStatus *status);
+// Finishes the queued exports, then stops the thread
+void FreeImageExporter(ImageExporter *exporter);
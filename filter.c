@@ -0,0 +1,99 @@
+#include "filter.h"
+#include <math.h>
+
+// Exponential smoothing factor for a first order low-pass at `cutoff` Hz, sampled every `dt` s
+static inline float smoothing(float cutoff, float dt) {
+        float tau = 1.0f / (2.0f * (float) M_PI * cutoff);
+        return 1.0f / (1.0f + tau / dt);
+}
+
+void FilterBegin(InputFilter *filter, float x, float y, uint32_t time) {
+        filter->x = filter->emitted_x = x;
+        filter->y = filter->emitted_y = y;
+        filter->dx = filter->dy = 0;
+        filter->time = time;
+        filter->lag = filter->max_trail = 0;
+}
+
+bool FilterSample(InputFilter *filter, float *x, float *y, uint32_t time) {
+        if (!filter->enabled) {
+                return true;
+        }
+
+        // SDL timestamps are in ms; events sharing one are still a sample apart
+        float dt = (time > filter->time) ? (float) (time - filter->time) * 1e-3f : 1e-3f;
+        filter->time = time;
+
+        const FilterConfig *config = &filter->config;
+        float a = smoothing(config->speed_cutoff, dt);
+        filter->dx += a * ((*x - filter->x) / dt - filter->dx);
+        filter->dy += a * ((*y - filter->y) / dt - filter->dy);
+
+        float cutoff = config->min_cutoff + config->beta * sqrtf(filter->dx * filter->dx + filter->dy * filter->dy);
+        a = smoothing(cutoff, dt);
+        filter->x += a * (*x - filter->x);
+        filter->y += a * (*y - filter->y);
+
+        // On a steady ramp the smoother trails its input by its time constant, whatever dt is;
+        // what shows on screen is how far behind that leaves it
+        filter->lag = 1000.0f / (2.0f * (float) M_PI * cutoff);
+        float tx = *x - filter->x, ty = *y - filter->y;
+        float trail = sqrtf(tx * tx + ty * ty);
+        if (trail > filter->max_trail) filter->max_trail = trail;
+
+        float ex = filter->x - filter->emitted_x, ey = filter->y - filter->emitted_y;
+        if (ex * ex + ey * ey < config->deadzone * config->deadzone) {
+                return false;
+        }
+
+        filter->emitted_x = *x = filter->x;
+        filter->emitted_y = *y = filter->y;
+        return true;
+}
+
+void PredictBegin(PenPredictor *predictor, float x, float y, uint32_t time) {
+        *predictor = (PenPredictor) { .x = x, .y = y, .time = time, .samples = 1 };
+}
+
+void PredictSample(PenPredictor *predictor, float x, float y, uint32_t time) {
+        float dt = (time > predictor->time) ? (float) (time - predictor->time) : 1.0f;
+        float vx = (x - predictor->x) / dt, vy = (y - predictor->y) / dt;
+
+        // Finite differences of a few samples are noisy; average them in
+        if (predictor->samples >= 2) {
+                float ax = (vx - predictor->vx) / dt, ay = (vy - predictor->vy) / dt;
+                predictor->ax = (predictor->samples >= 3) ? 0.5f * (predictor->ax + ax) : ax;
+                predictor->ay = (predictor->samples >= 3) ? 0.5f * (predictor->ay + ay) : ay;
+                vx = 0.5f * (predictor->vx + vx);
+                vy = 0.5f * (predictor->vy + vy);
+        }
+
+        predictor->x = x;
+        predictor->y = y;
+        predictor->vx = vx;
+        predictor->vy = vy;
+        predictor->time = time;
+        if (predictor->samples < 3) predictor->samples++;
+}
+
+bool PredictPosition(const PenPredictor *predictor, uint32_t now, float ahead, float *x, float *y) {
+        uint32_t since = (now > predictor->time) ? now - predictor->time : 0;
+        if (predictor->samples < 3 || since > PREDICT_IDLE_MS) {
+                return false;
+        }
+
+        float t = (float) since + ahead;
+        if (t > PREDICT_MAX_MS) t = PREDICT_MAX_MS;
+
+        // Acceleration is only trusted to bend the path, not to reverse it: a pen braking
+        // hard would otherwise be predicted to go backwards
+        float px = predictor->vx * t + 0.5f * predictor->ax * t * t;
+        float py = predictor->vy * t + 0.5f * predictor->ay * t * t;
+        if (px * predictor->vx + py * predictor->vy < 0) {
+                return false;
+        }
+
+        *x = predictor->x + px;
+        *y = predictor->y + py;
+        return true;
+}
@@ -0,0 +1,52 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+// One Euro filter (Casiez et al.): an exponential smoother whose cutoff rises with speed, so a
+// slow pen is smoothed hard (no jitter) and a fast one barely at all (no visible lag)
+typedef struct {
+        float min_cutoff;       // Hz, cutoff at rest
+        float beta;             // Hz of cutoff added per px/s of speed
+        float speed_cutoff;     // Hz, cutoff of the speed estimate itself
+        float deadzone;         // px, smoothed movement shorter than this isn't emitted
+} FilterConfig;
+
+#define FILTER_DEFAULTS ((FilterConfig) { .min_cutoff = 3.0f, .beta = 0.05f, .speed_cutoff = 5.0f, .deadzone = 0.5f })
+
+// Per stroke state: O(1) per sample, nothing allocated
+typedef struct {
+        FilterConfig config;
+        bool enabled;
+        float x, y;             // Smoothed position
+        float dx, dy;           // Smoothed velocity, px/s
+        float emitted_x, emitted_y;
+        uint32_t time;          // ms, timestamp of the last sample
+        float lag;              // ms the smoothed position trails the pen by, at the last sample
+        float max_trail;        // px, farthest a smoothed point has been from its sample since FilterBegin
+} InputFilter;
+
+// Starts a stroke at the pen down sample, which is emitted as is
+void FilterBegin(InputFilter *filter, float x, float y, uint32_t time);
+// Smooths the sample at *x, *y taken at `time` (ms) in place. Returns false when it is inside
+// the dead-zone of the last emitted point and should be dropped.
+bool FilterSample(InputFilter *filter, float *x, float *y, uint32_t time);
+
+#define PREDICT_MAX_MS 40.0f    // Furthest ahead the pen is ever extrapolated
+#define PREDICT_IDLE_MS 50      // A pen without samples for this long has stopped: no prediction
+
+// Recent velocity and acceleration of the emitted samples, to guess where the pen is now
+// rather than where it was when it was last reported
+typedef struct {
+        float x, y;             // Last sample
+        float vx, vy;           // px/ms
+        float ax, ay;           // px/ms^2
+        uint32_t time;          // ms
+        uint32_t samples;       // Since PredictBegin, saturating at 3
+} PenPredictor;
+
+void PredictBegin(PenPredictor *predictor, float x, float y, uint32_t time);
+void PredictSample(PenPredictor *predictor, float x, float y, uint32_t time);
+// Extrapolates the pen to `ahead` ms past `now`. Returns false when there is no motion to go
+// on: too few samples, or the pen has stopped.
+bool PredictPosition(const PenPredictor *predictor, uint32_t now, float ahead, float *x, float *y);
@@ -0,0 +1,268 @@
+#include "fit.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+        double x, y;
+} Vec2;
+
+static inline Vec2 vadd(Vec2 a, Vec2 b) { return (Vec2) { a.x + b.x, a.y + b.y }; }
+static inline Vec2 vsub(Vec2 a, Vec2 b) { return (Vec2) { a.x - b.x, a.y - b.y }; }
+static inline Vec2 vscale(Vec2 a, double s) { return (Vec2) { a.x * s, a.y * s }; }
+static inline double vdot(Vec2 a, Vec2 b) { return a.x * b.x + a.y * b.y; }
+
+static inline Vec2 vnormalize(Vec2 a) {
+        double length = sqrt(vdot(a, a));
+        return (length > 0) ? vscale(a, 1 / length) : a;
+}
+
+// A span of samples still to fit, with the unit tangents its ends must follow
+typedef struct {
+        uint32_t first, last;
+        Vec2 t1, t2;
+} FitSpan;
+
+// Grown to the longest stroke fitted so far
+static Vec2 *SAMPLES;
+static uint8_t *WIDTHS;
+static double *PARAMS;          // Curve parameter of each sample in the span being fitted
+static FitSpan *SPANS;
+static Point *CURVE;
+static uint32_t CAPACITY;
+
+static bool reserveScratch(uint32_t count) {
+        if (count <= CAPACITY) {
+                return true;
+        }
+
+        Vec2 *samples = realloc(SAMPLES, count * sizeof(Vec2));
+        if (samples) SAMPLES = samples;
+        uint8_t *widths = realloc(WIDTHS, count * sizeof(uint8_t));
+        if (widths) WIDTHS = widths;
+        double *params = realloc(PARAMS, count * sizeof(double));
+        if (params) PARAMS = params;
+        FitSpan *spans = realloc(SPANS, count * sizeof(FitSpan));
+        if (spans) SPANS = spans;
+        Point *curve = realloc(CURVE, (3 * (size_t) count + 1) * sizeof(Point));
+        if (curve) CURVE = curve;
+
+        if (!samples || !widths || !params || !spans || !curve) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                return false;
+        }
+
+        CAPACITY = count;
+        return true;
+}
+
+static Vec2 bezier(const Vec2 *c, double t) {
+        double s = 1 - t;
+        return (Vec2) {
+                s * s * s * c[0].x + 3 * s * s * t * c[1].x + 3 * s * t * t * c[2].x + t * t * t * c[3].x,
+                s * s * s * c[0].y + 3 * s * s * t * c[1].y + 3 * s * t * t * c[2].y + t * t * t * c[3].y,
+        };
+}
+
+static void chordLengthParameterize(uint32_t first, uint32_t last) {
+        PARAMS[first] = 0;
+        for (uint32_t i = first + 1; i <= last; i++) {
+                Vec2 d = vsub(SAMPLES[i], SAMPLES[i - 1]);
+                PARAMS[i] = PARAMS[i - 1] + sqrt(vdot(d, d));
+        }
+        for (uint32_t i = first + 1; i <= last; i++) {
+                PARAMS[i] /= PARAMS[last];
+        }
+}
+
+// Least squares control points for the span, with c1 and c2 along the end tangents
+static void generateBezier(uint32_t first, uint32_t last, Vec2 t1, Vec2 t2, Vec2 *c) {
+        Vec2 p0 = SAMPLES[first], p3 = SAMPLES[last];
+        double c00 = 0, c01 = 0, c11 = 0, x0 = 0, x1 = 0;
+
+        for (uint32_t i = first; i <= last; i++) {
+                double u = PARAMS[i], s = 1 - u;
+                double b0 = s * s * s, b1 = 3 * s * s * u, b2 = 3 * s * u * u, b3 = u * u * u;
+
+                Vec2 a1 = vscale(t1, b1), a2 = vscale(t2, b2);
+                c00 += vdot(a1, a1);
+                c01 += vdot(a1, a2);
+                c11 += vdot(a2, a2);
+
+                Vec2 rest = vsub(SAMPLES[i], vadd(vscale(p0, b0 + b1), vscale(p3, b2 + b3)));
+                x0 += vdot(a1, rest);
+                x1 += vdot(a2, rest);
+        }
+
+        double det = c00 * c11 - c01 * c01;
+        double length = sqrt(vdot(vsub(p3, p0), vsub(p3, p0)));
+        double alpha1 = 0, alpha2 = 0;
+        if (fabs(det) > 1e-12) {
+                alpha1 = (x0 * c11 - x1 * c01) / det;
+                alpha2 = (c00 * x1 - c01 * x0) / det;
+        }
+
+        // Degenerate, backwards or crossing handles (a few nearly collinear samples leave the
+        // system ill-conditioned): fall back to a third of the chord (Wu/Barsky heuristic)
+        Vec2 chord = vsub(p3, p0);
+        if (alpha1 < 1e-6 * length || alpha2 < 1e-6 * length ||
+            alpha1 * vdot(t1, chord) - alpha2 * vdot(t2, chord) > length * length) {
+                alpha1 = alpha2 = length / 3;
+        }
+
+        c[0] = p0;
+        c[1] = vadd(p0, vscale(t1, alpha1));
+        c[2] = vadd(p3, vscale(t2, alpha2));
+        c[3] = p3;
+}
+
+// Largest squared distance from an interior sample to the curve, and where it is
+static double maxError(uint32_t first, uint32_t last, const Vec2 *c, uint32_t *split) {
+        double worst = 0;
+        *split = first + (last - first + 1) / 2;
+
+        for (uint32_t i = first + 1; i < last; i++) {
+                Vec2 d = vsub(bezier(c, PARAMS[i]), SAMPLES[i]);
+                double e = vdot(d, d);
+                if (e >= worst) {
+                        worst = e;
+                        *split = i;
+                }
+        }
+        return worst;
+}
+
+// One Newton-Raphson step towards each sample's closest parameter on the curve
+static void reparameterize(uint32_t first, uint32_t last, const Vec2 *c) {
+        Vec2 d1[3] = { vscale(vsub(c[1], c[0]), 3), vscale(vsub(c[2], c[1]), 3), vscale(vsub(c[3], c[2]), 3) };
+        Vec2 d2[2] = { vscale(vsub(d1[1], d1[0]), 2), vscale(vsub(d1[2], d1[1]), 2) };
+
+        for (uint32_t i = first; i <= last; i++) {
+                double u = PARAMS[i], s = 1 - u;
+                Vec2 q = vsub(bezier(c, u), SAMPLES[i]);
+                Vec2 q1 = vadd(vadd(vscale(d1[0], s * s), vscale(d1[1], 2 * s * u)), vscale(d1[2], u * u));
+                Vec2 q2 = vadd(vscale(d2[0], s), vscale(d2[1], u));
+
+                double denominator = vdot(q1, q1) + vdot(q, q2);
+                if (denominator != 0) {
+                        // Outside [0, 1] the error would be measured against an extrapolated curve
+                        PARAMS[i] = fmin(fmax(u - vdot(q, q1) / denominator, 0), 1);
+                }
+        }
+}
+
+// Tangents where a span is split: shared by both halves (G1), unless the stroke turns sharply
+// there, in which case each half follows its own side and the corner stays a corner. Turns
+// between short edges are pixel steps of a slow stroke, not corners.
+static void splitTangents(uint32_t i, double error, Vec2 *left, Vec2 *right) {
+        Vec2 in = vsub(SAMPLES[i - 1], SAMPLES[i]);
+        Vec2 out = vsub(SAMPLES[i + 1], SAMPLES[i]);
+        Vec2 center = vnormalize(vsub(SAMPLES[i - 1], SAMPLES[i + 1]));
+        double shortest = 16 * error * error;
+        bool corner = vdot(in, in) > shortest && vdot(out, out) > shortest;
+
+        in = vnormalize(in);
+        out = vnormalize(out);
+        if ((corner && vdot(in, out) > FIT_CORNER) || vdot(center, center) == 0) {
+                *left = in;
+                *right = out;
+        } else {
+                *left = center;
+                *right = vscale(center, -1);
+        }
+}
+
+static uint32_t pushControl(uint32_t n, Vec2 p, uint8_t width) {
+        CURVE[n] = (Point) { .x = (float) p.x, .y = (float) p.y, .line_thickness = width, .connected_to_next_point = true };
+        return n + 1;
+}
+
+uint32_t FitCurves(const PointStore *points, uint32_t start, uint32_t end, float error, const Point **out) {
+        if (!reserveScratch(end - start + 1)) {
+                return 0;
+        }
+        *out = CURVE;
+
+        // Repeated samples carry no direction
+        uint32_t count = 0;
+        for (uint32_t i = start; i <= end; i++) {
+                Point p = LoadPoint(points, i);
+                if (count > 0 && SAMPLES[count - 1].x == p.x && SAMPLES[count - 1].y == p.y) {
+                        WIDTHS[count - 1] = p.line_thickness;
+                        continue;
+                }
+                SAMPLES[count] = (Vec2) { p.x, p.y };
+                WIDTHS[count] = p.line_thickness;
+                count++;
+        }
+
+        uint32_t n = pushControl(0, SAMPLES[0], WIDTHS[0]);
+        if (count == 1) {
+                // A dot: keep it a (zero length) segment so it still gets drawn
+                n = pushControl(n, SAMPLES[0], WIDTHS[0]);
+                CURVE[n - 1].connected_to_next_point = false;
+                return n;
+        }
+
+        double tolerance = (double) error * error;
+        uint32_t spans = 0;
+        SPANS[spans++] = (FitSpan) {
+                .first = 0,
+                .last = count - 1,
+                .t1 = vnormalize(vsub(SAMPLES[1], SAMPLES[0])),
+                .t2 = vnormalize(vsub(SAMPLES[count - 2], SAMPLES[count - 1])),
+        };
+
+        // Explicit stack, right half pushed first so segments come out in order
+        while (spans > 0) {
+                FitSpan span = SPANS[--spans];
+                Vec2 c[4];
+                uint32_t split;
+
+                if (span.last - span.first == 1) {
+                        double third = sqrt(vdot(vsub(SAMPLES[span.last], SAMPLES[span.first]), vsub(SAMPLES[span.last], SAMPLES[span.first]))) / 3;
+                        c[1] = vadd(SAMPLES[span.first], vscale(span.t1, third));
+                        c[2] = vadd(SAMPLES[span.last], vscale(span.t2, third));
+                } else {
+                        chordLengthParameterize(span.first, span.last);
+                        generateBezier(span.first, span.last, span.t1, span.t2, c);
+                        double worst = maxError(span.first, span.last, c, &split);
+
+                        for (int i = 0; i < FIT_ITERATIONS && worst > tolerance; i++) {
+                                reparameterize(span.first, span.last, c);
+                                generateBezier(span.first, span.last, span.t1, span.t2, c);
+                                worst = maxError(span.first, span.last, c, &split);
+                        }
+
+                        if (worst > tolerance) {
+                                Vec2 left, right;
+                                splitTangents(split, error, &left, &right);
+                                SPANS[spans++] = (FitSpan) { split, span.last, right, span.t2 };
+                                SPANS[spans++] = (FitSpan) { span.first, split, span.t1, left };
+                                continue;
+                        }
+                }
+
+                n = pushControl(n, c[1], WIDTHS[span.first]);
+                n = pushControl(n, c[2], WIDTHS[span.last]);
+                n = pushControl(n, SAMPLES[span.last], WIDTHS[span.last]);
+        }
+
+        CURVE[n - 1].connected_to_next_point = false;
+        return n;
+}
+
+void FreeFitScratch(void) {
+        free(SAMPLES);
+        free(WIDTHS);
+        free(PARAMS);
+        free(SPANS);
+        free(CURVE);
+        SAMPLES = NULL;
+        WIDTHS = NULL;
+        PARAMS = NULL;
+        SPANS = NULL;
+        CURVE = NULL;
+        CAPACITY = 0;
+}
@@ -0,0 +1,17 @@
+#include <stdint.h>
+
+#include "pointstore.h"
+
+#pragma once
+
+#define FIT_ERROR 0.5f          // Max distance (px) from a sample to the fitted curve
+#define FIT_ITERATIONS 4        // Newton-Raphson reparameterization passes before splitting
+#define FIT_CORNER -0.7f        // Cosine of the sharpest turn still smoothed over (about 135 degrees)
+
+// Fits G1-continuous (except at corners) cubic Beziers to points [start, end] (Schneider's algorithm) and returns
+// their control points in *out as p0 c1 c2 p1 c1 c2 p2 ...: 3 * segments + 1 points, each
+// segment sharing its end point with the next. That is the layout strokes are drawn from.
+// Returns the number of points, or 0 on allocation failure. *out is scratch owned by the
+// fitter, valid until the next call.
+uint32_t FitCurves(const PointStore *points, uint32_t start, uint32_t end, float error, const Point **out);
+void FreeFitScratch(void);
@@ -113,7 +113,13 @@ char* unique_name(char* folderLocation, char* prefix) {
         }
 }
 
-void SaveRendererAsImage(SDL_Renderer *renderer, char *Suffix, char *Location) {
+void SaveRendererAsImage(SDL_Renderer *renderer, ImageExporter *exporter, char *Suffix, char *Location) {
+        // Checked first so a turned away export doesn't cost a read-back
+        if (ExportQueueFull(exporter)) {
+                printf("Still saving earlier images, try again shortly\n");
+                return;
+        }
+
         int win_width, win_height;
         SDL_GetRendererOutputSize(renderer, &win_width, &win_height);
 
@@ -130,27 +136,14 @@ void SaveRendererAsImage(SDL_Renderer *renderer, char *Suffix, char *Location) {
                 return;
         }
 
-        char *file_name = unique_name(Location, Suffix);
-        if (file_name == NULL) {
-                printf("Error generating filename..\n");
-                SDL_FreeSurface(surface);
-                return;
-        }
-
         if (SDL_RenderReadPixels(renderer, NULL, surface -> format -> format, surface -> pixels, surface -> pitch) < 0) {
                 printf("Unable to read pixels: %s\n", SDL_GetError());
-                free(file_name);
                 SDL_FreeSurface(surface);
                 return;
         }
 
-        if (IMG_SavePNG(surface, file_name) != 0) {
-                printf("Unable to save frame as PNG: %s\n", IMG_GetError());
-                free(file_name);
-                return;
-        }
-        SDL_FreeSurface(surface);
-        free(file_name);
+        // Naming and encoding happen on the exporter's thread
+        QueueExport(exporter, (ExportJob) { .surface = surface, .location = Location, .prefix = Suffix });
 }
 
 void print_live_usage() {
@@ -11,6 +11,8 @@
 #include <sys/types.h>
 #include <wchar.h>
 
+#include "export.h"
+
 #define __DEBUG__(msg, ...)\
         printf("Debug at line %d: " msg "\n", __LINE__, ##__VA_ARGS__);\
         fflush(stdout);
@@ -18,6 +20,8 @@
 #pragma once
 void print_live_usage();
 SDL_Texture* LoadImageAsTexture(const char* path, SDL_Renderer* renderer);
-void SaveRendererAsImage(SDL_Renderer *renderer, char *Suffix, char *Location);
+// Reads the window back and queues it on `exporter` to be written as a PNG in Location
+void SaveRendererAsImage(SDL_Renderer *renderer, ImageExporter *exporter, char *Suffix, char *Location);
+char* unique_name(char* folderLocation, char* prefix);
 bool CollisionDetection(uint16_t x1, uint16_t y1, uint16_t w1, uint16_t h1, uint16_t x2, uint16_t y2, uint16_t w2, uint16_t h2);
 SDL_Cursor* createCursorFromPNG(const char* filename, uint8_t width, uint8_t height);
@@ -0,0 +1,89 @@
+#include "history.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Shows or hides what `op` added or removed, as it stands with `op` applied or not
+static void setApplied(LinesArray *PA, HistoryOp op, bool applied) {
+        bool hidden = (op.kind == HISTORY_REMOVE_STROKE) == applied;
+        if (op.kind == HISTORY_RASTER) {
+                PA->paint.ops[op.id].hidden = hidden;
+                return;
+        }
+
+        Stroke *s = &PA->strokes[op.id];
+        s->flags = hidden ? s->flags | STROKE_HIDDEN : s->flags & ~STROKE_HIDDEN;
+}
+
+// The stroke or paint `op` leaves hidden once it can no longer be undone or redone
+static void forget(LinesArray *PA, HistoryOp op, bool applied) {
+        bool hidden = (op.kind == HISTORY_REMOVE_STROKE) == applied;
+        if (!hidden) {
+                return;
+        }
+
+        if (op.kind == HISTORY_RASTER) {
+                DiscardPaintOp(&PA->paint, op.id);
+        } else {
+                DiscardStroke(PA, op.id);
+        }
+}
+
+int PushHistory(History *history, LinesArray *PA, enum HistoryOpKind kind, uint32_t id) {
+        for (uint32_t i = history->cursor; i < history->count; i++) {
+                forget(PA, history->ops[i], false);
+        }
+        history->count = history->cursor;
+
+        if (history->count >= HISTORY_LIMIT) {
+                // Drop the oldest half at once so this stays amortized O(1)
+                uint32_t dropped = HISTORY_LIMIT / 2;
+                for (uint32_t i = 0; i < dropped; i++) {
+                        forget(PA, history->ops[i], true);
+                }
+                memmove(history->ops, history->ops + dropped, (history->count - dropped) * sizeof(HistoryOp));
+                history->count -= dropped;
+        }
+
+        if (history->count >= history->capacity) {
+                uint32_t new_capacity = (history->capacity == 0) ? 64 : history->capacity << 1;
+
+                HistoryOp *temp = realloc(history->ops, new_capacity * sizeof(HistoryOp));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        history->cursor = history->count;
+                        return 1;
+                }
+                history->ops = temp;
+                history->capacity = new_capacity;
+        }
+
+        history->ops[history->count++] = (HistoryOp) { .id = id, .kind = kind };
+        history->cursor = history->count;
+        return 0;
+}
+
+int Undo(History *history, LinesArray *PA, HistoryOp *op) {
+        if (history->cursor == 0) {
+                return 1;
+        }
+
+        *op = history->ops[--history->cursor];
+        setApplied(PA, *op, false);
+        return 0;
+}
+
+int Redo(History *history, LinesArray *PA, HistoryOp *op) {
+        if (history->cursor == history->count) {
+                return 1;
+        }
+
+        *op = history->ops[history->cursor++];
+        setApplied(PA, *op, true);
+        return 0;
+}
+
+void FreeHistory(History *history) {
+        free(history->ops);
+        *history = (History) {0};
+}
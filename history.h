@@ -0,0 +1,37 @@
+#include <stdint.h>
+
+#include "point.h"
+
+#pragma once
+
+#define HISTORY_LIMIT 4096      // Most undoable operations; older ones become permanent
+
+enum HistoryOpKind: uint8_t {
+        HISTORY_ADD_STROKE,
+        HISTORY_REMOVE_STROKE,
+        HISTORY_RASTER,         // A paint op, which keeps only the tiles it dirtied
+};
+
+typedef struct {
+        uint32_t id;            // Stroke id, or paint op id for HISTORY_RASTER
+        enum HistoryOpKind kind;
+} HistoryOp;
+
+// Undo log over the stroke table and the paint layer. Operations only hide and show strokes
+// and paint ops, so undo and redo cost the same whatever the document holds; the caller
+// redraws the op's bounds.
+// Ops [0, cursor) are applied, [cursor, count) were undone and can be redone.
+typedef struct {
+        HistoryOp *ops;
+        uint32_t count, capacity;
+        uint32_t cursor;
+} History;
+
+// Records an op that has just been applied. Undone ops can't be redone past it, so strokes
+// and paint only they could bring back are discarded. Returns 1 on allocation failure.
+int PushHistory(History *history, LinesArray *PA, enum HistoryOpKind kind, uint32_t id);
+// Reverts the newest applied op and returns it in *op. Returns 1 when there is nothing to undo.
+int Undo(History *history, LinesArray *PA, HistoryOp *op);
+// Reapplies the oldest undone op. Returns 1 when there is nothing to redo.
+int Redo(History *history, LinesArray *PA, HistoryOp *op);
+void FreeHistory(History *history);
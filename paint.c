@@ -0,0 +1,207 @@
+#include "paint.h"
+#include <SDL2/SDL_error.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+
+// Tile holding world coordinate v, rounding towards -infinity
+static int tileOf(int v) {
+        return (v >= 0) ? v / PAINT_TILE : -((PAINT_TILE - 1 - v) / PAINT_TILE);
+}
+
+int BeginPaintOp(PaintLayer *layer, uint32_t z, uint32_t point, uint32_t *id) {
+        if (layer->count >= layer->capacity) {
+                uint32_t new_capacity = (layer->capacity == 0) ? 16 : layer->capacity << 1;
+
+                PaintOp *temp = realloc(layer->ops, new_capacity * sizeof(PaintOp));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return 1;
+                }
+                layer->ops = temp;
+                layer->capacity = new_capacity;
+        }
+
+        layer->ops[layer->count] = (PaintOp) { .z = z, .point = point };
+        *id = layer->count++;
+        return 0;
+}
+
+// The patch of `op` in the tile at column tx, row ty, grown to take in `area`; NULL on
+// allocation failure
+static PaintPatch* patchFor(PaintLayer *layer, PaintOp *op, int tx, int ty, SDL_Rect area) {
+        PaintPatch *patch = NULL;
+        for (uint32_t i = 0; i < op->patchCount; i++) {
+                SDL_Rect r = op->patches[i].rect;
+                if (tileOf(r.x) == tx && tileOf(r.y) == ty) {
+                        patch = &op->patches[i];
+                        break;
+                }
+        }
+
+        if (!patch) {
+                if (op->patchCount >= op->patchCapacity) {
+                        uint32_t new_capacity = (op->patchCapacity == 0) ? 4 : op->patchCapacity << 1;
+
+                        PaintPatch *temp = realloc(op->patches, new_capacity * sizeof(PaintPatch));
+                        if (!temp) {
+                                fprintf(stderr, "Memory allocation failed!\n");
+                                return NULL;
+                        }
+                        op->patches = temp;
+                        op->patchCapacity = new_capacity;
+                }
+
+                uint32_t *pixels = calloc((size_t) area.w * area.h, sizeof(uint32_t));
+                if (!pixels) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return NULL;
+                }
+                layer->bytes += (size_t) area.w * area.h * sizeof(uint32_t);
+                op->patches[op->patchCount] = (PaintPatch) { .rect = area, .pixels = pixels };
+                return &op->patches[op->patchCount++];
+        }
+
+        SDL_Rect grown;
+        SDL_UnionRect(&patch->rect, &area, &grown);
+        if (grown.w == patch->rect.w && grown.h == patch->rect.h) {
+                return patch;
+        }
+
+        // Only ever grows inside its tile, so it stays within a tile's worth of pixels
+        uint32_t *pixels = calloc((size_t) grown.w * grown.h, sizeof(uint32_t));
+        if (!pixels) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                return NULL;
+        }
+        SDL_Rect old = patch->rect;
+        for (int y = 0; y < old.h; y++) {
+                memcpy(pixels + (size_t) (old.y - grown.y + y) * grown.w + (old.x - grown.x),
+                       patch->pixels + (size_t) y * old.w, (size_t) old.w * sizeof(uint32_t));
+        }
+
+        layer->bytes += ((size_t) grown.w * grown.h - (size_t) old.w * old.h) * sizeof(uint32_t);
+        free(patch->pixels);
+        patch->pixels = pixels;
+        patch->rect = grown;
+        return patch;
+}
+
+int PaintRect(PaintLayer *layer, uint32_t id, SDL_Rect rect, SDL_Color color) {
+        if (id >= layer->count || rect.w <= 0 || rect.h <= 0) {
+                return 0;
+        }
+        PaintOp *op = &layer->ops[id];
+        uint32_t packed = PackColor(color);
+
+        int tx0 = tileOf(rect.x), tx1 = tileOf(rect.x + rect.w - 1);
+        int ty0 = tileOf(rect.y), ty1 = tileOf(rect.y + rect.h - 1);
+        for (int ty = ty0; ty <= ty1; ty++) {
+                for (int tx = tx0; tx <= tx1; tx++) {
+                        SDL_Rect tile = { tx * PAINT_TILE, ty * PAINT_TILE, PAINT_TILE, PAINT_TILE }, area;
+                        SDL_IntersectRect(&tile, &rect, &area);
+
+                        PaintPatch *patch = patchFor(layer, op, tx, ty, area);
+                        if (!patch) {
+                                return 1;
+                        }
+
+                        for (int y = area.y; y < area.y + area.h; y++) {
+                                uint32_t *row = patch->pixels + (size_t) (y - patch->rect.y) * patch->rect.w + (area.x - patch->rect.x);
+                                for (int x = 0; x < area.w; x++) row[x] = packed;
+                        }
+                }
+        }
+
+        if (op->bounds.w == 0) {
+                op->bounds = rect;
+        } else {
+                SDL_UnionRect(&op->bounds, &rect, &op->bounds);
+        }
+        return 0;
+}
+
+void DiscardPaintOp(PaintLayer *layer, uint32_t id) {
+        if (id >= layer->count) {
+                return;
+        }
+
+        PaintOp *op = &layer->ops[id];
+        for (uint32_t i = 0; i < op->patchCount; i++) {
+                layer->bytes -= (size_t) op->patches[i].rect.w * op->patches[i].rect.h * sizeof(uint32_t);
+                free(op->patches[i].pixels);
+        }
+        free(op->patches);
+        op->patches = NULL;
+        op->patchCount = op->patchCapacity = 0;
+        op->hidden = true;
+}
+
+void BlendPaintOp(RasterBuffer *RB, const PaintOp *op, int dx, int dy) {
+        for (uint32_t i = 0; i < op->patchCount; i++) {
+                const PaintPatch *patch = &op->patches[i];
+                SDL_Rect screen = { patch->rect.x + dx, patch->rect.y + dy, patch->rect.w, patch->rect.h }, area;
+                if (!SDL_IntersectRect(&screen, &RB->clip, &area)) {
+                        continue;
+                }
+
+                for (int y = area.y; y < area.y + area.h; y++) {
+                        const uint32_t *src = patch->pixels + (size_t) (y - screen.y) * patch->rect.w + (area.x - screen.x);
+                        uint32_t *dst = RB->pixels + (size_t) y * RB->width + area.x;
+                        for (int x = 0; x < area.w; x++) {
+                                uint32_t p = src[x];
+                                if ((p >> 24) == 255) {
+                                        dst[x] = p;
+                                } else if (p >> 24) {
+                                        SDL_Color color = { (p >> 16) & 0xFF, (p >> 8) & 0xFF, p & 0xFF, p >> 24 };
+                                        BlendPixel(RB, area.x + x, y, color, 1.0f);
+                                }
+                        }
+                }
+        }
+}
+
+// Patches are uploaded through this one at a time. Only the UI thread draws through the renderer.
+static SDL_Texture *PATCH_TEXTURE;
+
+void RenderPaintOp(SDL_Renderer *renderer, const PaintOp *op, int dx, int dy) {
+        if (op->patchCount == 0) {
+                return;
+        }
+
+        if (!PATCH_TEXTURE) {
+                PATCH_TEXTURE = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, PAINT_TILE, PAINT_TILE);
+                if (!PATCH_TEXTURE) {
+                        fprintf(stderr, "Failed to create texture: %s\n", SDL_GetError());
+                        return;
+                }
+                SDL_SetTextureBlendMode(PATCH_TEXTURE, SDL_BLENDMODE_BLEND);
+        }
+
+        for (uint32_t i = 0; i < op->patchCount; i++) {
+                const PaintPatch *patch = &op->patches[i];
+                SDL_Rect src = { 0, 0, patch->rect.w, patch->rect.h };
+                SDL_Rect dst = { patch->rect.x + dx, patch->rect.y + dy, patch->rect.w, patch->rect.h };
+
+                SDL_UpdateTexture(PATCH_TEXTURE, &src, patch->pixels, patch->rect.w * (int) sizeof(uint32_t));
+                SDL_RenderCopy(renderer, PATCH_TEXTURE, &src, &dst);
+                CountDrawCalls(1);
+        }
+}
+
+void FreePaintScratch(void) {
+        if (PATCH_TEXTURE) {
+                SDL_DestroyTexture(PATCH_TEXTURE);
+                PATCH_TEXTURE = NULL;
+        }
+}
+
+void FreePaintLayer(PaintLayer *layer) {
+        for (uint32_t i = 0; i < layer->count; i++) {
+                DiscardPaintOp(layer, i);
+        }
+        free(layer->ops);
+        *layer = (PaintLayer) {0};
+}
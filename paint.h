@@ -0,0 +1,54 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_render.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "raster.h"
+
+#pragma once
+
+#define PAINT_TILE 128          // Side of the world-space squares paint is kept in
+
+// What a paint op set inside one world tile
+typedef struct {
+        SDL_Rect rect;          // World pixels, never crossing a PAINT_TILE edge
+        uint32_t *pixels;       // rect.w * rect.h ARGB, straight alpha; 0 where nothing was painted
+} PaintPatch;
+
+// An edit that only exists as pixels, like an erasor rectangle or a pasted image. Only the
+// parts of the tiles it touched are kept, in world space, so it pans with the strokes. It is
+// drawn in order with them: over strokes [0, z), under the rest.
+typedef struct {
+        PaintPatch *patches;
+        uint32_t patchCount, patchCapacity;
+        SDL_Rect bounds;        // World pixels, over every patch
+        uint32_t z;
+        uint32_t point;         // Points there were when it was made
+        bool hidden;            // Undone: kept, but never drawn
+} PaintOp;
+
+// Paint ops in the order they were made, which is also z order
+typedef struct {
+        PaintOp *ops;
+        uint32_t count, capacity;
+        size_t bytes;           // Of patch pixels
+} PaintLayer;
+
+// Starts an empty op over strokes [0, z), made with `point` points down, and returns its id in
+// *id. Returns 1 on allocation failure.
+int BeginPaintOp(PaintLayer *layer, uint32_t z, uint32_t point, uint32_t *id);
+// Sets the world pixels of `rect` to `color` in op `id`. Returns 1 on allocation failure, which
+// can leave part of rect painted.
+int PaintRect(PaintLayer *layer, uint32_t id, SDL_Rect rect, SDL_Color color);
+// Frees the pixels of op `id` for good and hides it. Its slot stays, so later ids don't move.
+void DiscardPaintOp(PaintLayer *layer, uint32_t id);
+
+// Composites `op` into RB's clip, world (0, 0) landing on pixel (dx, dy)
+void BlendPaintOp(RasterBuffer *RB, const PaintOp *op, int dx, int dy);
+// Same through the renderer, one tile at a time
+void RenderPaintOp(SDL_Renderer *renderer, const PaintOp *op, int dx, int dy);
+void FreePaintScratch(void);
+void FreePaintLayer(PaintLayer *layer);
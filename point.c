@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "document.h"
+
 #define unpack_color(color) (color.r), (color.g), (color.b), (color.a)
 #define swap(a, b) \
         do { \
@@ -17,7 +19,7 @@
                 *a = *b; \
                 *b = temp; \
         } while (0)
-#define fpart(x) ((x) - (int)(x))
+#define fpart(x) ((x) - floorf(x))
 #define rfpart(x) (1.0f - fpart(x))
 
 static int SCREEN_WIDTH, SCREEN_HEIGHT;
@@ -26,63 +28,47 @@ void set_window_dimensions(int win_width, int win_height) {
         SCREEN_HEIGHT = win_height;
 }
 
-double perpendicularDistance(Point pt, Point lineStart, Point lineEnd) {
-        double dx = lineEnd.x - lineStart.x;
-        double dy = lineEnd.y - lineStart.y;
-
-        if (dx == 0 && dy == 0) {
-                dx = pt.x - lineStart.x;
-                dy = pt.y - lineStart.y;
-                return sqrt(dx * dx + dy * dy);
-        }
-
-        double num = fabs(dy * pt.x - dx * pt.y + lineEnd.x * lineStart.y - lineEnd.y * lineStart.x);
-        double den = sqrt(dx * dx + dy * dy);
-        return num / den;
+// When set, lines are rasterized into this buffer instead of going through the renderer.
+// Per thread, so tile workers can each draw into their own clip of the canvas.
+static _Thread_local RasterBuffer *RASTER_TARGET = NULL;
+void set_raster_target(RasterBuffer *RB) {
+        RASTER_TARGET = RB;
 }
 
-int addPoint(LinesArray* PA, float x, float y, uint8_t line_thickness, bool connected_to_prev_line) {
-        if (PA->pointCapacity >= UINT16_MAX) {
-                return 1;
+// Area anything is actually drawn to: the raster clip rect, or the whole window
+static SDL_FRect renderView(void) {
+        if (RASTER_TARGET) {
+                SDL_Rect clip = RASTER_TARGET->clip;
+                return (SDL_FRect) { clip.x, clip.y, clip.w, clip.h };
         }
+        return (SDL_FRect) { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+}
 
-        if (PA->pointCount >= PA->pointCapacity) {
-                uint16_t new_capacity = (PA->pointCapacity == 0) ? 1 : PA->pointCapacity << 1;
-
-                if (new_capacity >= UINT16_MAX) {
-                        new_capacity = UINT16_MAX;
-                }
-
-                Point* temp = realloc(PA->points, new_capacity * sizeof(Point));
-                if (!temp) {
-                        fprintf(stderr, "Memory allocation failed!\n");
-                        return 1;
-                }
-                PA->points = temp;
-                PA->pointCapacity = new_capacity;
-        }
-
-        PA->points[PA->pointCount].x = x;
-        PA->points[PA->pointCount].y = y;
-        PA->points[PA->pointCount].connected_to_next_point = connected_to_prev_line;
-        PA->points[PA->pointCount].line_thickness = line_thickness;
-        PA->pointCount++;
-
-        return 0;
+// Appends an input sample to the live stroke, dropping ones it doesn't need as they arrive
+int StreamPoint(LinesArray* PA, float x, float y, uint8_t line_thickness, bool connected_to_prev_line) {
+        return StreamAppend(&PA->stream, &PA->points, LiveStrokeStart(PA), (Point) {
+                .x = x,
+                .y = y,
+                .line_thickness = line_thickness,
+                .connected_to_next_point = connected_to_prev_line,
+        });
 }
 
 void setPixel(SDL_Renderer* renderer, float x, float y, SDL_Color color, float intensity) {
-        color.a *= intensity;
+        if (RASTER_TARGET) {
+                BlendPixel(RASTER_TARGET, (int) x, (int) y, color, intensity);
+                return;
+        }
 
-        SDL_SetRenderDrawBlendMode(renderer, (color.a == 255) ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
-        SDL_SetRenderDrawColor(renderer, unpack_color(color));
-        SDL_RenderDrawPointF(renderer, x, y);
+        // Batched: drawn in a handful of calls by FlushPointBatch
+        BatchPoint(renderer, x, y, color, intensity);
 }
 
 // Wu's Algorithm: Wikipedia
 void BetterLine(SDL_Renderer* renderer, float x0, float y0, float x1, float y1, SDL_Color color) {
-        if ((x0 < 0 && x1 < 0) || (x0 > SCREEN_WIDTH && x1 > SCREEN_WIDTH) ||
-            (y0 < 0 && y1 < 0) || (y0 > SCREEN_HEIGHT && y1 > SCREEN_HEIGHT)) {
+        SDL_FRect view = renderView();
+        if ((x0 < view.x - 1 && x1 < view.x - 1) || (x0 > view.x + view.w && x1 > view.x + view.w) ||
+            (y0 < view.y - 1 && y1 < view.y - 1) || (y0 > view.y + view.h && y1 > view.y + view.h)) {
                 return;  // Line is outside the screen
         }
 
@@ -108,7 +94,7 @@ void BetterLine(SDL_Renderer* renderer, float x0, float y0, float x1, float y1,
         float xend = x0;
         float yend = y0 + gradient * (xend - x0);
         float xgap = rfpart(x0 + 0.5f);
-        int xpxl1 = (int)xend;
+        int xpxl1 = (int)floorf(xend);
         int ypxl1 = (int)floorf(yend);
 
         if (steep) {
@@ -125,7 +111,7 @@ void BetterLine(SDL_Renderer* renderer, float x0, float y0, float x1, float y1,
         xend = x1;
         yend = y1 + gradient * (xend - x1);
         xgap = fpart(x1 + 0.5f);
-        int xpxl2 = (int)xend;
+        int xpxl2 = (int)floorf(xend);
         int ypxl2 = (int)floorf(yend);
 
         if (steep) {
@@ -137,6 +123,11 @@ void BetterLine(SDL_Renderer* renderer, float x0, float y0, float x1, float y1,
         }
 
         // Main loop
+        if (RASTER_TARGET) {
+                RasterWuSpan(RASTER_TARGET, xpxl1 + 1, xpxl2, intery, gradient, steep, color);
+                return;
+        }
+
         for (int x = xpxl1 + 1; x < xpxl2; x++) {
                 int y = (int)floorf(intery);
                 float frac = fpart(intery);
@@ -153,200 +144,649 @@ void BetterLine(SDL_Renderer* renderer, float x0, float y0, float x1, float y1,
         }
 }
 
-Point lerp(Point a, Point b, float t) {
-        return (Point) {
-                .x = a.x + (b.x - a.x) * t,
-                .y = a.y + (b.y - a.y) * t,
-        };
+// Appends the curve (without p0, which the stroke already ends on) to `line` in screen space.
+// Forward differencing: three adds per step instead of six lerps.
+void flattenBezierCurve(Polyline *line, Point p0, Point p1, Point p2, Point p3, Pan pan, int steps) {
+        float h = 1.0f / steps, h2 = h * h, h3 = h2 * h;
+
+        // B(t) = a t^3 + b t^2 + c t + p0
+        float ax = -p0.x + 3 * p1.x - 3 * p2.x + p3.x, ay = -p0.y + 3 * p1.y - 3 * p2.y + p3.y;
+        float bx = 3 * p0.x - 6 * p1.x + 3 * p2.x, by = 3 * p0.y - 6 * p1.y + 3 * p2.y;
+        float cx = -3 * p0.x + 3 * p1.x, cy = -3 * p0.y + 3 * p1.y;
+
+        float x = p0.x, y = p0.y;
+        float dx = ax * h3 + bx * h2 + cx * h, dy = ay * h3 + by * h2 + cy * h;
+        float ddx = 6 * ax * h3 + 2 * bx * h2, ddy = 6 * ay * h3 + 2 * by * h2;
+        float dddx = 6 * ax * h3, dddy = 6 * ay * h3;
+
+        for (int i = 1; i < steps; i++) {
+                x += dx; y += dy;
+                dx += ddx; dy += ddy;
+                ddx += dddx; ddy += dddy;
+
+                float w = p0.line_thickness + (p3.line_thickness - p0.line_thickness) * (i * h);
+                pushPolylinePoint(line, x + pan.x, y + pan.y, w);
+        }
+
+        // Land exactly on p3 so accumulated error never leaks into the next segment
+        pushPolylinePoint(line, p3.x + pan.x, p3.y + pan.y, p3.line_thickness);
 }
 
-void renderBezierCurve(SDL_Renderer *renderer, Point p0, Point p1, Point p2, Point p3, Pan pan, int steps, SDL_Color color) {
-        Point prev = p0;
+#define FLATNESS_TOLERANCE 0.25f        // Max screen-space distance (px) between curve and chords
+#define MAX_BEZIER_STEPS 200
 
-        for (int i = 1; i <= steps; i++) {
-                float t = i / (float)steps;
+// Wang's formula: the fewest chords keeping the curve within FLATNESS_TOLERANCE,
+// further capped by the control polygon length so tiny segments get one or two chords
+int estimateSteps(Point p0, Point p1, Point p2, Point p3) {
+        float d1 = hypotf(p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y);
+        float d2 = hypotf(p1.x - 2 * p2.x + p3.x, p1.y - 2 * p2.y + p3.y);
+        int steps = (int) ceilf(sqrtf(0.75f * fmaxf(d1, d2) / FLATNESS_TOLERANCE));
 
-                Point a = lerp(p0, p1, t);
-                Point b = lerp(p1, p2, t);
-                Point c = lerp(p2, p3, t);
+        float length = hypotf(p1.x - p0.x, p1.y - p0.y) + hypotf(p2.x - p1.x, p2.y - p1.y) + hypotf(p3.x - p2.x, p3.y - p2.y);
+        int by_length = (int) ceilf(length * 0.5f); // Never shorter than ~2px per chord
 
-                Point d = lerp(a, b, t);
-                Point e = lerp(b, c, t);
+        if (steps > by_length) steps = by_length;
+        if (steps < 1) steps = 1;
+        if (steps > MAX_BEZIER_STEPS) steps = MAX_BEZIER_STEPS;
 
-                Point f = lerp(d, e, t); // Final point on curve
+        return steps;
+}
 
-                BetterLine(renderer, prev.x + pan.x, prev.y + pan.y, f.x + pan.x, f.y + pan.y, color);
-                prev = f;
+// Flattened stroke currently being rendered, reused across calls (one per thread)
+static _Thread_local Polyline STROKE_LINE;
+static _Thread_local StrokeMesh STROKE_MESH;
+// Points of the stroke being rendered, decoded or copied out of the store
+static _Thread_local Point *STROKE_POINTS;
+static _Thread_local uint32_t STROKE_POINTS_CAPACITY;
+
+// Flattens a group of 2-4 points: a straight segment or a cubic Bezier
+static void flattenGroup(Point *arr, int count, Pan pan) {
+        switch (count) {
+                case 2:
+                        pushPolylinePoint(&STROKE_LINE, arr[1].x + pan.x, arr[1].y + pan.y, arr[1].line_thickness);
+                        break;
+                case 3:
+                        flattenBezierCurve(&STROKE_LINE, arr[0], arr[1], arr[2], arr[2], pan, estimateSteps(arr[0], arr[1], arr[2], arr[2]));
+                        break;
+                case 4:
+                        flattenBezierCurve(&STROKE_LINE, arr[0], arr[1], arr[2], arr[3], pan, estimateSteps(arr[0], arr[1], arr[2], arr[3]));
+                        break;
         }
 }
 
-int estimateSteps(Point p0, Point p1, Point p2, Point p3) {
-        float maxDeviation = fmaxf(perpendicularDistance(p0, p3, p1), perpendicularDistance(p0, p3, p2));
-        float length = hypotf(p3.x - p0.x, p3.y - p0.y);
+// Translucent strokes on the renderer path are drawn opaque in here and composited once with
+// their alpha, since overlapping triangles would blend twice. Window sized, made on first use.
+static _Thread_local SDL_Texture *STROKE_LAYER;
+
+static SDL_Texture* strokeLayer(SDL_Renderer* renderer) {
+        int w, h;
+        if (STROKE_LAYER && (SDL_QueryTexture(STROKE_LAYER, NULL, NULL, &w, &h) != 0 || w != SCREEN_WIDTH || h != SCREEN_HEIGHT)) {
+                SDL_DestroyTexture(STROKE_LAYER);
+                STROKE_LAYER = NULL;
+        }
+
+        if (!STROKE_LAYER) {
+                STROKE_LAYER = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+                if (STROKE_LAYER) {
+                        SDL_SetTextureBlendMode(STROKE_LAYER, SDL_BLENDMODE_BLEND);
+                }
+        }
+        return STROKE_LAYER;
+}
 
-        // Normalize deviation
-        if (length < 1e-5f) {
-                length = 1e-5f;
+// Draws STROKE_MESH through the renderer. Its fringe gives the edges their anti-aliasing.
+static void renderMesh(SDL_Renderer* renderer, SDL_Color color) {
+        SDL_Texture *layer = (color.a < 255) ? strokeLayer(renderer) : NULL;
+        if (!layer) {
+                // Opaque: overlaps only blend the same color again
+                SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+                SDL_RenderGeometry(renderer, NULL, STROKE_MESH.vertices, STROKE_MESH.vertexCount, STROKE_MESH.indices, STROKE_MESH.indexCount);
+                CountDrawCalls(1);
+                return;
         }
-        float deviationFactor = maxDeviation / length;
 
-        // Clamp steps to sane values
-        int steps = (int)(70 + deviationFactor * 200); // from 70 (flat) to 200 (curvy)
-        if (steps < 70) steps = 70;
-        if (steps > 200) steps = 200;
+        float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+        for (uint32_t i = 0; i < STROKE_MESH.vertexCount; i++) {
+                SDL_Vertex *v = &STROKE_MESH.vertices[i];
+                x0 = fminf(x0, v->position.x); y0 = fminf(y0, v->position.y);
+                x1 = fmaxf(x1, v->position.x); y1 = fmaxf(y1, v->position.y);
 
-        return steps;
+                // Opaque in the layer; the whole stroke takes color.a when it's composited
+                v->color.a = (uint8_t) (v->color.a * 255 / color.a);
+        }
+
+        SDL_Rect area = { (int) floorf(x0), (int) floorf(y0), (int) ceilf(x1) - (int) floorf(x0) + 1, (int) ceilf(y1) - (int) floorf(y0) + 1 };
+        SDL_Rect screen = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+        if (!SDL_IntersectRect(&area, &screen, &area)) {
+                return;
+        }
+
+        SDL_Texture *target = SDL_GetRenderTarget(renderer);
+        SDL_SetRenderTarget(renderer, layer);
+
+        // Cleared to the stroke's color at alpha 0, so the fringe doesn't blend towards black
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 0);
+        SDL_RenderFillRect(renderer, &area);
+
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_RenderGeometry(renderer, NULL, STROKE_MESH.vertices, STROKE_MESH.vertexCount, STROKE_MESH.indices, STROKE_MESH.indexCount);
+
+        SDL_SetRenderTarget(renderer, target);
+        SDL_SetTextureAlphaMod(layer, color.a);
+        SDL_RenderCopy(renderer, layer, &area, &area);
+        CountDrawCalls(3);
+}
+
+// Draws STROKE_LINE and empties it. 1px strokes are Wu lines; thicker ones are tessellated
+// into one mesh, whose fill is also what anti-aliases its edges.
+static void renderStroke(SDL_Renderer* renderer, SDL_Color color) {
+        Polyline *line = &STROKE_LINE;
+        FlatPoint *p = line->points;
+
+        float width = 0;
+        for (uint32_t i = 0; i < line->count; i++) {
+                width = fmaxf(width, p[i].w);
+        }
+
+        if (width <= 1.0f) {
+                for (uint32_t i = 1; i < line->count; i++) {
+                        BetterLine(renderer, p[i - 1].x, p[i - 1].y, p[i].x, p[i].y, color);
+                }
+                line->count = 0;
+                return;
+        }
+
+        // The CPU fill works out edge coverage itself; the renderer needs the fringe for it
+        bool fringe = RASTER_TARGET == NULL;
+        if (TessellateStroke(line, JOIN_ROUND, color, renderView(), fringe, &STROKE_MESH) == 0 && STROKE_MESH.indexCount > 0) {
+                if (RASTER_TARGET) {
+                        RasterFillTriangles(RASTER_TARGET, STROKE_MESH.vertices, STROKE_MESH.indices, STROKE_MESH.indexCount);
+                } else {
+                        renderMesh(renderer, color);
+                }
+        }
+
+        line->count = 0;
+}
+
+void FreeStrokeScratch(void) {
+        FreeRasterScratch();
+        FreePolyline(&STROKE_LINE);
+        FreeStrokeMesh(&STROKE_MESH);
+        free(STROKE_POINTS);
+        STROKE_POINTS = NULL;
+        STROKE_POINTS_CAPACITY = 0;
+        if (STROKE_LAYER) {
+                SDL_DestroyTexture(STROKE_LAYER);
+                STROKE_LAYER = NULL;
+        }
 }
 
+static Point* strokePoints(uint32_t count) {
+        if (count > STROKE_POINTS_CAPACITY) {
+                Point *temp = realloc(STROKE_POINTS, count * sizeof(Point));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return NULL;
+                }
+                STROKE_POINTS = temp;
+                STROKE_POINTS_CAPACITY = count;
+        }
+        return STROKE_POINTS;
+}
 
-void __RenderLines__(SDL_Renderer* renderer, LinesArray *PA, Pan pan, uint16_t line_start_index, uint16_t line_end_index, SDL_Color color) {
-        if (line_end_index == line_start_index) {
+// Renders a run of points, split into strokes by their connectivity
+static void renderPoints(SDL_Renderer* renderer, const Point *points, uint32_t count, Pan pan, SDL_Color color) {
+        if (count < 2) {
                 return;
         }
         Point arr[4];
         int temp = 0;
 
-        for (int i = line_start_index; i <= line_end_index; i++) {
-                arr[temp] = PA->points[i];
+        for (uint32_t i = 0; i < count; i++) {
+                arr[temp] = points[i];
                 temp++;
 
-                if (!PA->points[i].connected_to_next_point) {
-                        // Handle disconnected segments
-                        if (temp == 2) {
-                                BetterLine(renderer, arr[0].x + pan.x, arr[0].y + pan.y, arr[1].x + pan.x, arr[1].y + pan.y, color);
-                                SDL_SetRenderDrawColor(renderer, unpack_color(color));
-                        } else if (temp == 3) {
-                                int steps = estimateSteps(arr[0], arr[1], arr[2], arr[2]);
-                                renderBezierCurve(renderer, arr[0], arr[1], arr[2], arr[2], pan, steps, color);
-                        }
-
-                        temp = 0;
+                if (STROKE_LINE.count == 0) {
+                        pushPolylinePoint(&STROKE_LINE, arr[0].x + pan.x, arr[0].y + pan.y, arr[0].line_thickness);
                 }
 
-                if (temp == 4) {
-                        int steps = estimateSteps(arr[0], arr[1], arr[2], arr[3]);
-                        renderBezierCurve(renderer, arr[0], arr[1], arr[2], arr[3], pan, steps, color);
+                if (!points[i].connected_to_next_point) {
+                        // End of stroke
+                        flattenGroup(arr, temp, pan);
+                        renderStroke(renderer, color);
+                        temp = 0;
+                } else if (temp == 4) {
+                        flattenGroup(arr, temp, pan);
                         arr[0] = arr[3];
                         temp = 1;
                 }
         }
 
         // Handle leftovers
-        if (temp == 2) {
-                BetterLine(renderer, arr[0].x + pan.x, arr[0].y + pan.y, arr[1].x + pan.x, arr[1].y + pan.y, color);
-        } else if (temp == 3) {
-                int steps = estimateSteps(arr[0], arr[1], arr[2], arr[2]);
-                renderBezierCurve(renderer, arr[0], arr[1], arr[2], arr[2], pan, steps, color);
-        } else if (temp == 4) {
-                int steps = estimateSteps(arr[0], arr[1], arr[2], arr[3]);
-                renderBezierCurve(renderer, arr[0], arr[1], arr[2], arr[3], pan, steps, color);
+        flattenGroup(arr, temp, pan);
+        renderStroke(renderer, color);
+}
+
+// Renders points [start, end] of committed stroke `id`, decoding it first
+static void renderStrokeRange(SDL_Renderer* renderer, LinesArray *PA, Pan pan, uint32_t id, uint32_t start, uint32_t end, SDL_Color color) {
+        Stroke *stroke = &PA->strokes[id];
+        uint32_t first = stroke->first_point;
+        uint32_t last = first + stroke->point_count - 1;
+        if (last < start || first > end) {
+                return;
+        }
+
+        Point *points = strokePoints(stroke->point_count);
+        if (!points) {
+                return;
+        }
+        DecodePoints(stroke->data, stroke->point_count, points);
+
+        if (start < first) start = first;
+        if (end > last) end = last;
+        renderPoints(renderer, points + (start - first), end - start + 1, pan, color);
+}
+
+// Renders live points [start, end]
+static void renderLiveRange(SDL_Renderer* renderer, LinesArray *PA, Pan pan, uint32_t start, uint32_t end, SDL_Color color) {
+        if (start < PA->points.first) start = PA->points.first;
+        if (end >= PA->points.count) end = PA->points.count - 1;
+        if (start > end) {
+                return;
+        }
+
+        Point *points = strokePoints(end - start + 1);
+        if (!points) {
+                return;
+        }
+        for (uint32_t i = start; i <= end; i++) {
+                points[i - start] = LoadPoint(&PA->points, i);
         }
+        renderPoints(renderer, points, end - start + 1, pan, color);
+}
 
-        PA->rendered_till = PA->pointCount - 1;
+static bool boundsVisible(Bounds b, Pan pan) {
+        SDL_FRect view = renderView();
+        return b.x1 + pan.x >= view.x && b.x0 + pan.x <= view.x + view.w &&
+               b.y1 + pan.y >= view.y && b.y0 + pan.y <= view.y + view.h;
+}
+
+// Renders points [start, end], skipping committed strokes whose bounds are outside the view.
+// Points past the last committed stroke (the one being drawn) are always rendered.
+void RenderVisibleLines(SDL_Renderer* renderer, LinesArray *PA, Pan pan, uint32_t start, uint32_t end, SDL_Color color) {
+        if (PA->points.count == 0 || start > end) {
+                return;
+        }
+
+        SDL_FRect view = renderView();
+        Bounds world = { view.x - pan.x, view.y - pan.y, view.x + view.w - pan.x, view.y + view.h - pan.y };
+
+        const uint32_t *ids;
+        uint32_t count = QueryStrokes(PA, world, &ids);
+        RenderStrokeIds(renderer, PA, pan, ids, count, start, end, color);
+
+        PA->rendered_till = PA->points.count - 1;
+}
+
+// Draws paint op `id` if it was made within points [start, end] and is in view. An op made
+// before any point counts as part of a render from 0.
+static void renderPaintOp(SDL_Renderer* renderer, LinesArray *PA, Pan pan, uint32_t id, uint32_t start, uint32_t end) {
+        PaintOp *op = &PA->paint.ops[id];
+        if (op->hidden || (uint64_t) op->point > (uint64_t) end + 1 || (op->point <= start && start != 0)) {
+                return;
+        }
+
+        SDL_FRect view = renderView();
+        int dx = (int) floor(pan.x), dy = (int) floor(pan.y);
+        if (op->bounds.x + dx + op->bounds.w < view.x || op->bounds.x + dx > view.x + view.w ||
+            op->bounds.y + dy + op->bounds.h < view.y || op->bounds.y + dy > view.y + view.h) {
+                return;
+        }
+
+        if (RASTER_TARGET) {
+                BlendPaintOp(RASTER_TARGET, op, dx, dy);
+        } else {
+                FlushPointBatch(renderer);
+                RenderPaintOp(renderer, op, dx, dy);
+        }
+}
+
+// Renders the given strokes (ascending ids) clipped to points [start, end] in their own color,
+// skipping hidden ones and any outside the view, plus the live stroke in `color`. Paint ops
+// made in that range go between the strokes they were made between.
+// Touches nothing shared, so workers can call it.
+void RenderStrokeIds(SDL_Renderer* renderer, LinesArray *PA, Pan pan, const uint32_t *ids, uint32_t count, uint32_t start, uint32_t end, SDL_Color color) {
+        if (PA->points.count == 0 || start > end) {
+                return;
+        }
+
+        uint32_t op = 0;
+        for (uint32_t i = 0; i < count; i++) {
+                for (; op < PA->paint.count && PA->paint.ops[op].z <= ids[i]; op++) {
+                        renderPaintOp(renderer, PA, pan, op, start, end);
+                }
+
+                Stroke *stroke = &PA->strokes[ids[i]];
+                if ((stroke->flags & STROKE_HIDDEN) || !boundsVisible(stroke->bounds, pan)) {
+                        continue;
+                }
+
+                renderStrokeRange(renderer, PA, pan, ids[i], start, end, stroke->color);
+        }
+        for (; op < PA->paint.count; op++) {
+                renderPaintOp(renderer, PA, pan, op, start, end);
+        }
+
+        // Not yet committed
+        renderLiveRange(renderer, PA, pan, start, end, color);
+
+        if (!RASTER_TARGET) {
+                FlushPointBatch(renderer);
+        }
 }
 
 void ReRenderLines(SDL_Renderer* renderer, LinesArray *PA, Pan pan, SDL_Color color) {
-        if (PA->pointCount != 0) {
-                __RenderLines__(renderer, PA, pan, 0, PA->pointCount - 1, color);
+        if (PA->points.count != 0) {
+                RenderVisibleLines(renderer, PA, pan, 0, PA->points.count - 1, color);
         }
 }
 
-void RenderLine(SDL_Renderer* renderer, LinesArray* PA, Pan pan, uint16_t start_index, uint16_t end_index, SDL_Color color) {
-        if (PA == NULL || PA->pointCount == 0){
+void RenderLine(SDL_Renderer* renderer, LinesArray* PA, Pan pan, uint32_t start_index, uint32_t end_index, SDL_Color color) {
+        if (PA == NULL || PA->points.count == 0){
                 return;
         }
 
         SDL_SetRenderDrawColor(renderer, unpack_color(color));
-        uint16_t rendered_till = start_index;
-        while (rendered_till < end_index - 1) {
-                if (PA->points[rendered_till].connected_to_next_point && PA->points[rendered_till + 1].connected_to_next_point) {
+        uint32_t rendered_till = (start_index > PA->points.first) ? start_index : PA->points.first; // Only live points are held
+        while (rendered_till + 1 < end_index) {
+                if (PointConnected(&PA->points, rendered_till) && PointConnected(&PA->points, rendered_till + 1)) {
+                        Point a = LoadPoint(&PA->points, rendered_till), b = LoadPoint(&PA->points, rendered_till + 1);
                         SDL_RenderDrawLine(renderer,
-                                (int) (PA->points[rendered_till].x + pan.x),
-                                (int) (PA->points[rendered_till].y + pan.y),
-                                (int) (PA->points[rendered_till + 1].x + pan.x),
-                                (int) (PA->points[rendered_till + 1].y + pan.y)
+                                (int) (a.x + pan.x),
+                                (int) (a.y + pan.y),
+                                (int) (b.x + pan.x),
+                                (int) (b.y + pan.y)
                         );
+                        CountDrawCalls(1);
                 }
                 rendered_till += 1;
         }
 }
 
+// Provisional segment from the newest live point to (x, y), where the pen is predicted to be.
+// It's drawn over the frame and never stored, so the next frame replaces it with real samples.
+void RenderPrediction(SDL_Renderer* renderer, LinesArray* PA, Pan pan, float x, float y, SDL_Color color) {
+        if (PA == NULL || PA->points.count == PA->points.first || !PointConnected(&PA->points, PA->points.count - 1)) {
+                return;
+        }
+
+        Point last = LoadPoint(&PA->points, PA->points.count - 1);
+        SDL_SetRenderDrawColor(renderer, unpack_color(color));
+        SDL_RenderDrawLine(renderer, (int) (last.x + pan.x), (int) (last.y + pan.y), (int) (x + pan.x), (int) (y + pan.y));
+        CountDrawCalls(1);
+}
+
+// World-space box around live points [start, end] including their stroke width.
+// Bezier curves stay inside their control points' hull, so the points are enough.
+static Bounds measureLines(LinesArray *PA, uint32_t start, uint32_t end, uint8_t *width) {
+        Bounds b = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+        uint8_t w = 1;
+
+        if (start < PA->points.first) {
+                start = PA->points.first;
+        }
+        if (end >= PA->points.count) {
+                end = PA->points.count - 1;
+        }
+
+        for (uint32_t i = start; PA->points.count != 0 && i <= end;) {
+                PointChunk *chunk;
+                uint32_t offset;
+                uint32_t n = PointRun(&PA->points, i, end, &chunk, &offset);
+
+                for (uint32_t k = offset; k < offset + n; k++) {
+                        b.x0 = fminf(b.x0, chunk->x[k]); b.y0 = fminf(b.y0, chunk->y[k]);
+                        b.x1 = fmaxf(b.x1, chunk->x[k]); b.y1 = fmaxf(b.y1, chunk->y[k]);
+                        w = (chunk->width[k] > w) ? chunk->width[k] : w;
+                }
+                i += n;
+        }
+
+        float pad = w * 0.5f + 2;
+        b.x0 -= pad; b.y0 -= pad;
+        b.x1 += pad; b.y1 += pad;
+
+        if (width) *width = w;
+        return b;
+}
+
+// Committed strokes in the range count with their whole stored bounds
+static SDL_Rect screenRect(Bounds b, Pan pan) {
+        return (SDL_Rect) {
+                .x = (int) floorf(b.x0 + pan.x),
+                .y = (int) floorf(b.y0 + pan.y),
+                .w = (int) ceilf(b.x1 - b.x0) + 1,
+                .h = (int) ceilf(b.y1 - b.y0) + 1,
+        };
+}
+
+SDL_Rect StrokeScreenBounds(LinesArray *PA, uint32_t id, Pan pan) {
+        if (id >= PA->strokeCount) {
+                return (SDL_Rect) {0};
+        }
+
+        return screenRect(PA->strokes[id].bounds, pan);
+}
+
+SDL_Rect PaintScreenBounds(LinesArray *PA, uint32_t id, Pan pan) {
+        if (id >= PA->paint.count) {
+                return (SDL_Rect) {0};
+        }
+
+        SDL_Rect r = PA->paint.ops[id].bounds;
+        r.x += (int) floor(pan.x);
+        r.y += (int) floor(pan.y);
+        return r;
+}
+
+// First point of the stroke being drawn: everything after the last committed stroke
+uint32_t LiveStrokeStart(LinesArray *PA) {
+        if (PA->strokeCount == 0) {
+                return 0;
+        }
+
+        Stroke *last = &PA->strokes[PA->strokeCount - 1];
+        return last->first_point + last->point_count;
+}
+
 void PanPoints(Pan* pan, float xrel, float yrel) {
         pan->x += xrel;
         pan->y += yrel;
 }
 
-void douglasPeucker(Point* points, int start, int end, double epsilon, bool* keep) {
-        if (end <= start + 1) {
-                keep[start] = true;
-                return;
+// Records the live stroke in the stroke table and the spatial index, and moves its points
+// out of the point store into the stroke's compressed data. Returns 1, leaving the stroke
+// live, when it can't be stored.
+int CommitStroke(LinesArray* PA, SDL_Color color) {
+        uint32_t start = LiveStrokeStart(PA);
+        if (start >= PA->points.count) {
+                return 1;
         }
 
-        double maxDist = 0.0;
-        int index = start;
+        if (PA->strokeCount >= PA->strokeCapacity) {
+                if (PA->strokeCapacity > UINT32_MAX / 2 / sizeof(Stroke)) {
+                        return 1;
+                }
+                uint32_t new_capacity = (PA->strokeCapacity == 0) ? 16 : PA->strokeCapacity << 1;
 
-        for (int i = start + 1; i < end; ++i) {
-                double dist = perpendicularDistance(points[i], points[start], points[end]);
-                if (dist > maxDist) {
-                        maxDist = dist;
-                        index = i;
+                Stroke* temp = realloc(PA->strokes, new_capacity * sizeof(Stroke));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return 1;
                 }
+                PA->strokes = temp;
+                PA->strokeCapacity = new_capacity;
+        }
+
+        uint32_t size;
+        uint8_t *data = EncodePoints(&PA->points, start, PA->points.count - 1, &size);
+        if (!data) {
+                return 1;
         }
 
-        if (maxDist >= epsilon) {
-                keep[index] = true;
-                douglasPeucker(points, start, index, epsilon, keep);
-                douglasPeucker(points, index, end, epsilon, keep);
+        uint8_t width;
+        Bounds bounds = measureLines(PA, start, PA->points.count - 1, &width);
+        if (SpatialInsert(&PA->index, PA->strokeCount, bounds) != 0) {
+                // May have got into some cells; the id is handed out again next time
+                SpatialRemove(&PA->index, PA->strokeCount, bounds);
+                free(data);
+                return 1;
         }
+
+        PA->strokes[PA->strokeCount++] = (Stroke) {
+                .bounds = bounds,
+                .first_point = start,
+                .point_count = PA->points.count - start,
+                .width = width,
+                .color = color,
+                .data = data,
+                .data_size = size,
+        };
+        ReleasePoints(&PA->points);
+
+        return 0;
 }
 
-float calculateEpsilon(Point* points, int count) {
-        float total = 0;
-        int valid = 0;
+void DiscardLiveStroke(LinesArray *PA) {
+        TruncatePoints(&PA->points, LiveStrokeStart(PA));
+        PA->stream.count = 0;
+        PA->rendered_till = PA->points.count;
+}
+
+static float segmentDistance(float px, float py, Point a, Point b) {
+        float dx = b.x - a.x, dy = b.y - a.y;
+        float len2 = dx * dx + dy * dy;
+        float t = (len2 > 0) ? ((px - a.x) * dx + (py - a.y) * dy) / len2 : 0;
+        t = fmaxf(0, fminf(1, t));
+        return hypotf(px - (a.x + t * dx), py - (a.y + t * dy));
+}
 
-        for (int i = 1; i < count - 1; i++) {
-                float d = perpendicularDistance(points[0], points[count - 1], points[i]);
-                total += d;
-                valid++;
+// SpatialQuery that first checks the point blocks of document strokes it returns for the first
+// time, so a document costs what's looked at. A stroke whose block is damaged is hidden.
+// Not for workers: it changes stroke flags.
+uint32_t QueryStrokes(LinesArray *PA, Bounds area, const uint32_t **ids) {
+        uint32_t count = SpatialQuery(&PA->index, area, ids);
+        if (PA->unchecked == 0) {
+                return count;
         }
 
-        float mean = (valid > 0) ? (total / valid) : 0;
+        for (uint32_t i = 0; i < count; i++) {
+                Stroke *stroke = &PA->strokes[(*ids)[i]];
+                if (!(stroke->flags & STROKE_UNCHECKED)) {
+                        continue;
+                }
 
-        total = 0;
-        for (int i = 1; i < count - 1; i++) {
-                float d = perpendicularDistance(points[0], points[count - 1], points[i]);
-                total += pow(d - mean, 2);
+                stroke->flags &= ~STROKE_UNCHECKED;
+                PA->unchecked--;
+                if (!CheckStrokeData(stroke)) {
+                        fprintf(stderr, "Stroke %u is damaged, hiding it\n", (*ids)[i]);
+                        stroke->flags |= STROKE_HIDDEN;
+                }
         }
-
-        float stddev = sqrt(total / (count));
-        return stddev * 2e-3f;
+        return count;
 }
 
+// Topmost committed stroke within `radius` of world point (x, y), or -1.
+// Distance is measured to the control polygon, which the curve stays close to.
+int StrokeAt(LinesArray *PA, float x, float y, float radius) {
+        const uint32_t *ids;
+        uint32_t count = QueryStrokes(PA, (Bounds) { x - radius, y - radius, x + radius, y + radius }, &ids);
+
+        for (uint32_t i = count; i-- > 0;) {
+                Stroke *stroke = &PA->strokes[ids[i]];
+                if (stroke->flags & STROKE_HIDDEN) {
+                        continue;
+                }
+
+                Point *p = strokePoints(stroke->point_count);
+                if (!p) {
+                        return -1;
+                }
+                DecodePoints(stroke->data, stroke->point_count, p);
+
+                for (uint32_t j = 0; j < stroke->point_count; j++) {
+                        Point b = (j + 1 < stroke->point_count) ? p[j + 1] : p[j];
+                        if (segmentDistance(x, y, p[j], b) <= radius + p[j].line_thickness * 0.5f) {
+                                return (int) ids[i];
+                        }
+                }
+        }
+
+        return -1;
+}
 
-void OptimizeLine(LinesArray* PA, uint16_t line_start_index, uint16_t line_end_index) {
-        if (PA->pointCount == 0) return;
+// Hides stroke `id` for good: its points are freed and it leaves the spatial index. Its slot
+// in the table stays, so later ids don't move.
+void DiscardStroke(LinesArray *PA, uint32_t id) {
+        Stroke *stroke = &PA->strokes[id];
+        if (!stroke->data) {
+                return;
+        }
 
-        double epsilon = calculateEpsilon(PA->points, PA->pointCount);
-        bool* keep = calloc(PA->pointCount, sizeof(int));
-        douglasPeucker(PA->points, line_start_index, line_end_index, epsilon, keep);
-        keep[line_start_index] = 1;
-        keep[line_end_index] = 1;
+        SpatialRemove(&PA->index, id, stroke->bounds);
+        if (!(stroke->flags & STROKE_MAPPED)) {
+                free(stroke->data);
+        }
+        if (stroke->flags & STROKE_UNCHECKED) {
+                stroke->flags &= ~STROKE_UNCHECKED;
+                PA->unchecked--;
+        }
+        stroke->data = NULL;
+        stroke->data_size = 0;
+        stroke->flags |= STROKE_HIDDEN;
+}
 
-        uint16_t temp = 0;
-        for (int i = line_start_index; i <= line_end_index; ++i) {
-                if (keep[i]) {
-                        PA->points[line_start_index + temp] = PA->points[i];
-                        temp += 1;
+void FreeLinesArray(LinesArray *PA) {
+        FreePointStore(&PA->points);
+        for (uint32_t i = 0; i < PA->strokeCount; i++) {
+                if (!(PA->strokes[i].flags & STROKE_MAPPED)) {
+                        free(PA->strokes[i].data);
                 }
         }
+        free(PA->strokes);
+        FreeSpatialIndex(&PA->index);
+        FreePaintLayer(&PA->paint);
+        *PA = (LinesArray) {0};
+}
+
+// Replaces live points [line_start_index, line_end_index] with the control points of cubic
+// curves fitted through them, which is how strokes are drawn (see renderPoints)
+void OptimizeLine(LinesArray* PA, uint32_t line_start_index, uint32_t line_end_index) {
+        if (line_start_index < PA->points.first || line_end_index >= PA->points.count || line_start_index > line_end_index) return;
+
+        // Thinning first keeps the fit, which is far more work per point, proportional to the
+        // stroke's shape rather than to how many samples it took to draw
+        float epsilon = SimplifyEpsilon(&PA->points, line_start_index, line_end_index);
+        uint32_t kept = SimplifyRange(&PA->points, line_start_index, line_end_index, epsilon);
+        line_end_index = line_start_index + kept - 1;
+        TruncatePoints(&PA->points, line_end_index + 1);
+
+        const Point *curve;
+        uint32_t count = FitCurves(&PA->points, line_start_index, line_end_index, FIT_ERROR, &curve);
+        if (count != 0) {
+                TruncatePoints(&PA->points, line_start_index);
+                for (uint32_t i = 0; i < count && AppendPoint(&PA->points, curve[i]) == 0; i++);
+        }
 
-        PA->pointCount = line_start_index + temp;
-        PA->rendered_till = PA->pointCount;
-        free(keep);
+        PA->rendered_till = PA->points.count;
 }
 
 #undef unwrap_color
 #undef swap
 #undef POINTS_THRESHOLD
+#undef FLATNESS_TOLERANCE
+#undef MAX_BEZIER_STEPS
 #undef fpart
 #undef rfpart
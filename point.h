@@ -6,29 +6,70 @@
 #include <math.h>
 #include <stdint.h>
 
+#include "batch.h"
+#include "fit.h"
+#include "paint.h"
+#include "pointstore.h"
+#include "raster.h"
+#include "simplify.h"
+#include "spatial.h"
+#include "stroke.h"
+
 #pragma once
 
 typedef struct {
        double x, y;
 } Pan;
 
+enum StrokeFlags: uint8_t {
+        STROKE_HIDDEN = 1 << 0, // Erased or undone: kept, but never drawn or hit
+        STROKE_MAPPED = 1 << 1, // Data lies in a mapped document, not malloc'd
+        STROKE_UNCHECKED = 1 << 2,      // Mapped data not yet checked against its checksum
+};
+
+// A committed stroke: points [first_point, first_point + point_count)
 typedef struct {
-        float x, y;
-        uint8_t line_thickness;
-        bool connected_to_next_point;
-} Point;
+        Bounds bounds;
+        uint32_t first_point;
+        uint32_t point_count;
+        uint8_t width;          // Widest point
+        uint8_t flags;          // enum StrokeFlags
+        SDL_Color color;
+        uint8_t *data;          // The points, packed by EncodePoints
+        uint32_t data_size;
+        uint32_t checksum;      // Of data, for strokes loaded from a document
+} Stroke;
 
 typedef struct {
-        Point *points;  // Pointer to dynamic array of points
-        uint16_t pointCount; // Current number of points
-        uint16_t pointCapacity;      // Max capacity of the array
-        uint16_t rendered_till;
+        PointStore points;      // Live stroke's points; points.count is the total ever indexed
+        StreamWindow stream;    // Input-time simplification of the live stroke
+        Stroke *strokes;        // Committed strokes, in point order; points after the last one are the live stroke
+        SpatialIndex index;     // Stroke bounds -> stroke ids (index into strokes)
+        PaintLayer paint;       // Pixel edits, drawn in order with the strokes
+        uint32_t rendered_till;
+        uint32_t unchecked;     // Strokes still STROKE_UNCHECKED
+        uint32_t strokeCount;
+        uint32_t strokeCapacity;
 } LinesArray;
 
+void FreeStrokeScratch(void);
+void RenderVisibleLines(SDL_Renderer* renderer, LinesArray *PA, Pan pan, uint32_t start, uint32_t end, SDL_Color color);
+uint32_t QueryStrokes(LinesArray *PA, Bounds area, const uint32_t **ids);
+int StrokeAt(LinesArray *PA, float x, float y, float radius);
+void FreeLinesArray(LinesArray *PA);
+void RenderStrokeIds(SDL_Renderer* renderer, LinesArray *PA, Pan pan, const uint32_t *ids, uint32_t count, uint32_t start, uint32_t end, SDL_Color color);
+SDL_Rect StrokeScreenBounds(LinesArray *PA, uint32_t id, Pan pan);
+SDL_Rect PaintScreenBounds(LinesArray *PA, uint32_t id, Pan pan);
+uint32_t LiveStrokeStart(LinesArray *PA);
+int CommitStroke(LinesArray *PA, SDL_Color color);
+// Drops the points of the live stroke, e.g. when it can't be committed
+void DiscardLiveStroke(LinesArray *PA);
+void DiscardStroke(LinesArray *PA, uint32_t id);
 void PanPoints(Pan* pan, float xrel, float yrel);
 void set_window_dimensions(int win_width, int win_height);
+void set_raster_target(RasterBuffer *RB);
 void ReRenderLines(SDL_Renderer* renderer, LinesArray *PA, Pan pan, SDL_Color color);
-void OptimizeLine(LinesArray* PA, uint16_t line_start_index, uint16_t line_end_index);
-int addPoint(LinesArray* PA, float x, float y, uint8_t line_thickness, bool connected_to_prev_line);
-void RenderLine(SDL_Renderer* renderer, LinesArray* PA, Pan pan, uint16_t start_index, uint16_t end_index, SDL_Color color);
-void __RenderLines__(SDL_Renderer* renderer, LinesArray *PA, Pan pan, uint16_t line_start_index, uint16_t line_end_index, SDL_Color color);
+void OptimizeLine(LinesArray* PA, uint32_t line_start_index, uint32_t line_end_index);
+int StreamPoint(LinesArray* PA, float x, float y, uint8_t line_thickness, bool connected_to_prev_line);
+void RenderLine(SDL_Renderer* renderer, LinesArray* PA, Pan pan, uint32_t start_index, uint32_t end_index, SDL_Color color);
+void RenderPrediction(SDL_Renderer* renderer, LinesArray* PA, Pan pan, float x, float y, SDL_Color color);
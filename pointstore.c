@@ -0,0 +1,137 @@
+#include "pointstore.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int addChunk(PointStore *store) {
+        if (store->chunkCount >= store->chunkCapacity) {
+                uint32_t new_capacity = (store->chunkCapacity == 0) ? 16 : store->chunkCapacity << 1;
+
+                PointChunk **temp = realloc(store->chunks, new_capacity * sizeof(PointChunk *));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return 1;
+                }
+                store->chunks = temp;
+                store->chunkCapacity = new_capacity;
+        }
+
+        PointChunk *chunk = malloc(sizeof(PointChunk));
+        if (!chunk) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                return 1;
+        }
+
+        store->chunks[store->chunkCount++] = chunk;
+        return 0;
+}
+
+int AppendPoint(PointStore *store, Point p) {
+        if (store->count == UINT32_MAX) {
+                return 1;
+        }
+
+        if (((store->count - store->first) >> POINT_CHUNK_SHIFT) >= store->chunkCount && addChunk(store) != 0) {
+                return 1;
+        }
+
+        StorePoint(store, store->count++, p);
+        return 0;
+}
+
+void TruncatePoints(PointStore *store, uint32_t count) {
+        if (count < store->first) {
+                count = store->first;
+        }
+        if (count < store->count) {
+                store->count = count;
+        }
+}
+
+void ReleasePoints(PointStore *store) {
+        store->first = store->count;
+}
+
+static inline uint8_t* putVarint(uint8_t *out, int32_t value) {
+        uint32_t v = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31); // Zigzag: small magnitudes -> small codes
+        while (v >= 0x80) {
+                *out++ = (uint8_t) (v | 0x80);
+                v >>= 7;
+        }
+        *out++ = (uint8_t) v;
+        return out;
+}
+
+static inline const uint8_t* getVarint(const uint8_t *in, int32_t *value) {
+        uint32_t v = 0;
+        for (int shift = 0;; shift += 7) {
+                uint8_t byte = *in++;
+                v |= (uint32_t) (byte & 0x7F) << shift;
+                if (!(byte & 0x80)) break;
+        }
+        *value = (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+        return in;
+}
+
+#define MAX_VARINT_BYTES 5
+
+uint8_t* EncodePoints(const PointStore *store, uint32_t start, uint32_t end, uint32_t *size) {
+        uint32_t count = end - start + 1;
+        uint8_t *data = malloc((size_t) count * 3 * MAX_VARINT_BYTES);
+        if (!data) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                return NULL;
+        }
+
+        uint8_t *out = data;
+        int32_t px = 0, py = 0, pw = 0;
+        for (uint32_t i = start; i <= end;) {
+                PointChunk *chunk;
+                uint32_t offset;
+                uint32_t n = PointRun(store, i, end, &chunk, &offset);
+
+                for (uint32_t k = offset; k < offset + n; k++) {
+                        int32_t x = (int32_t) lrintf(chunk->x[k] * POINT_QUANTUM);
+                        int32_t y = (int32_t) lrintf(chunk->y[k] * POINT_QUANTUM);
+                        int32_t w = chunk->width[k];
+
+                        out = putVarint(out, x - px);
+                        out = putVarint(out, y - py);
+                        out = putVarint(out, w - pw);
+                        px = x; py = y; pw = w;
+                }
+                i += n;
+        }
+
+        *size = (uint32_t) (out - data);
+        uint8_t *shrunk = realloc(data, *size);
+        return shrunk ? shrunk : data;
+}
+
+void DecodePoints(const uint8_t *data, uint32_t count, Point *out) {
+        int32_t x = 0, y = 0, w = 0;
+        for (uint32_t i = 0; i < count; i++) {
+                int32_t dx, dy, dw;
+                data = getVarint(data, &dx);
+                data = getVarint(data, &dy);
+                data = getVarint(data, &dw);
+                x += dx; y += dy; w += dw;
+
+                out[i] = (Point) {
+                        .x = x / POINT_QUANTUM,
+                        .y = y / POINT_QUANTUM,
+                        .line_thickness = (uint8_t) w,
+                        .connected_to_next_point = i + 1 < count,
+                };
+        }
+}
+
+#undef MAX_VARINT_BYTES
+
+void FreePointStore(PointStore *store) {
+        for (uint32_t i = 0; i < store->chunkCount; i++) {
+                free(store->chunks[i]);
+        }
+        free(store->chunks);
+        *store = (PointStore) {0};
+}
@@ -0,0 +1,93 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+// One point as a value; the store keeps its fields in separate arrays
+typedef struct {
+        float x, y;
+        uint8_t line_thickness;
+        bool connected_to_next_point;
+} Point;
+
+#define POINT_CHUNK_SHIFT 12
+#define POINT_CHUNK_SIZE (1u << POINT_CHUNK_SHIFT)      // Points per chunk
+#define POINT_CHUNK_MASK (POINT_CHUNK_SIZE - 1)
+
+// Structure of arrays, so scans over coordinates don't drag widths and flags through the cache
+typedef struct {
+        float x[POINT_CHUNK_SIZE];
+        float y[POINT_CHUNK_SIZE];
+        uint8_t width[POINT_CHUNK_SIZE];
+        uint64_t connected[POINT_CHUNK_SIZE / 64];      // Bit set: connected to the next point
+} PointChunk;
+
+// Points in fixed size chunks, addressed by a 32-bit index. Chunks never move once
+// allocated, so appending is O(1): it fills the last chunk or allocates a new one, and
+// only the small table of chunk pointers is ever reallocated.
+// Only points [first, count) are held; earlier ones have been handed off (see ReleasePoints).
+typedef struct {
+        PointChunk **chunks;
+        uint32_t chunkCount;    // Allocated chunks, possibly more than `count` needs
+        uint32_t chunkCapacity;
+        uint32_t first;
+        uint32_t count;
+} PointStore;
+
+static inline PointChunk* ChunkOf(const PointStore *store, uint32_t i) {
+        return store->chunks[(i - store->first) >> POINT_CHUNK_SHIFT];
+}
+
+static inline bool PointConnected(const PointStore *store, uint32_t i) {
+        uint32_t j = (i - store->first) & POINT_CHUNK_MASK;
+        return (ChunkOf(store, i)->connected[j >> 6] >> (j & 63)) & 1;
+}
+
+static inline Point LoadPoint(const PointStore *store, uint32_t i) {
+        PointChunk *chunk = ChunkOf(store, i);
+        uint32_t j = (i - store->first) & POINT_CHUNK_MASK;
+        return (Point) {
+                .x = chunk->x[j],
+                .y = chunk->y[j],
+                .line_thickness = chunk->width[j],
+                .connected_to_next_point = (chunk->connected[j >> 6] >> (j & 63)) & 1,
+        };
+}
+
+static inline void StorePoint(PointStore *store, uint32_t i, Point p) {
+        PointChunk *chunk = ChunkOf(store, i);
+        uint32_t j = (i - store->first) & POINT_CHUNK_MASK;
+        uint64_t bit = (uint64_t) 1 << (j & 63);
+
+        chunk->x[j] = p.x;
+        chunk->y[j] = p.y;
+        chunk->width[j] = p.line_thickness;
+        chunk->connected[j >> 6] = p.connected_to_next_point ? chunk->connected[j >> 6] | bit : chunk->connected[j >> 6] & ~bit;
+}
+
+// Contiguous slice of points [i, end] that lies in one chunk: returns its length and
+// the offset of i inside `*chunk`. Loops walk a range run by run.
+static inline uint32_t PointRun(const PointStore *store, uint32_t i, uint32_t end, PointChunk **chunk, uint32_t *offset) {
+        *chunk = ChunkOf(store, i);
+        *offset = (i - store->first) & POINT_CHUNK_MASK;
+
+        uint32_t length = POINT_CHUNK_SIZE - *offset;
+        return (end - i + 1 < length) ? end - i + 1 : length;
+}
+
+// Appends p at index `count`. Returns 1 when out of memory or indices.
+int AppendPoint(PointStore *store, Point p);
+// Drops points from `count` (at least `first`) on; their chunks are kept for reuse
+void TruncatePoints(PointStore *store, uint32_t count);
+// Stops holding every point: indices keep counting from `count`, and the chunks are reused
+void ReleasePoints(PointStore *store);
+void FreePointStore(PointStore *store);
+
+#define POINT_QUANTUM 4.0f      // Encoded coordinates are stored in 1/4 px steps
+
+// Packs points [start, end] as zigzag varints: x and y as POINT_QUANTUM fixed point deltas
+// from the previous point, and the change in width. Connectivity isn't stored: every point but
+// the last connects to the next. Returns a malloc'd buffer of *size bytes, or NULL.
+uint8_t* EncodePoints(const PointStore *store, uint32_t start, uint32_t end, uint32_t *size);
+// Unpacks `count` points encoded by EncodePoints into `out`
+void DecodePoints(const uint8_t *data, uint32_t count, Point *out);
@@ -0,0 +1,666 @@
+#include "raster.h"
+#include <SDL2/SDL_error.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+        #include <immintrin.h>
+        #define RASTER_X86
+#endif
+
+#define FILL_SUBROWS 4          // Samples down each row an edge's coverage is measured at
+
+typedef void (*WuSpanKernel)(RasterBuffer *RB, int x, int x_end, float intery, float gradient, bool steep, SDL_Color color);
+
+static void releaseTexture(RasterBuffer *RB, SDL_Texture *texture) {
+        if (RB->pool) {
+                ReleaseTexture(RB->pool, texture);
+        } else {
+                SDL_DestroyTexture(texture);
+        }
+}
+
+int CreateRasterBuffer(RasterBuffer *RB, SDL_Renderer *renderer, int width, int height, TexturePool *pool) {
+        RB->pixels = NULL;
+        RB->texture = NULL;
+        RB->width = 0;
+        RB->height = 0;
+        RB->clip = (SDL_Rect) {0};
+        RB->pool = pool;
+
+        return ResizeRasterBuffer(RB, renderer, width, height);
+}
+
+int ResizeRasterBuffer(RasterBuffer *RB, SDL_Renderer *renderer, int width, int height) {
+        if (RB->pixels != NULL && RB->width == width && RB->height == height) {
+                return 0;
+        }
+
+        uint32_t *pixels = malloc((size_t) width * height * sizeof(uint32_t));
+        if (!pixels) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                return 1;
+        }
+
+        SDL_Texture *texture = RB->pool
+                ? AcquireTexture(RB->pool, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height)
+                : SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+        if (!texture) {
+                fprintf(stderr, "Failed to create texture: %s\n", SDL_GetError());
+                free(pixels);
+                return 1;
+        }
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+        // The top-left overlap is kept, so a resize only has the newly exposed strips to draw
+        if (RB->pixels) {
+                int w = (RB->width < width) ? RB->width : width;
+                int h = (RB->height < height) ? RB->height : height;
+                for (int y = 0; y < h; y++) {
+                        memcpy(pixels + (size_t) y * width, RB->pixels + (size_t) y * RB->width, (size_t) w * sizeof(uint32_t));
+                }
+                free(RB->pixels);
+        }
+        RB->pixels = pixels;
+
+        if (RB->texture) {
+                releaseTexture(RB, RB->texture);
+        }
+        RB->texture = texture;
+        RB->width = width;
+        RB->height = height;
+        SetRasterClip(RB, NULL);
+
+        return 0;
+}
+
+void ClearRasterBuffer(RasterBuffer *RB, SDL_Color color) {
+        uint32_t packed = PackColor(color);
+        size_t count = (size_t) RB->width * RB->height;
+
+        if (packed == 0) {
+                memset(RB->pixels, 0, count * sizeof(uint32_t));
+                return;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+                RB->pixels[i] = packed;
+        }
+}
+
+void ClearRasterRect(RasterBuffer *RB, SDL_Rect rect, SDL_Color color) {
+        SDL_Rect full = { 0, 0, RB->width, RB->height };
+        if (!SDL_IntersectRect(&rect, &full, &rect)) {
+                return;
+        }
+
+        uint32_t packed = PackColor(color);
+        for (int y = rect.y; y < rect.y + rect.h; y++) {
+                uint32_t *row = &RB->pixels[y * RB->width + rect.x];
+                for (int x = 0; x < rect.w; x++) {
+                        row[x] = packed;
+                }
+        }
+}
+
+void UploadRasterBuffer(RasterBuffer *RB) {
+        SDL_UpdateTexture(RB->texture, NULL, RB->pixels, RB->width * (int) sizeof(uint32_t));
+}
+
+void UploadRasterRect(RasterBuffer *RB, SDL_Rect rect) {
+        SDL_Rect full = { 0, 0, RB->width, RB->height };
+        if (!SDL_IntersectRect(&rect, &full, &rect)) {
+                return;
+        }
+
+        SDL_UpdateTexture(RB->texture, &rect, &RB->pixels[rect.y * RB->width + rect.x], RB->width * (int) sizeof(uint32_t));
+}
+
+void ScrollRasterBuffer(RasterBuffer *RB, int dx, int dy) {
+        int w = RB->width - abs(dx), h = RB->height - abs(dy);
+        if (w <= 0 || h <= 0 || (dx == 0 && dy == 0)) {
+                return;
+        }
+
+        int src_x = (dx < 0) ? -dx : 0, dst_x = (dx > 0) ? dx : 0;
+
+        // Walk rows away from the direction of motion so sources are read before being overwritten
+        for (int i = 0; i < h; i++) {
+                int y = (dy > 0) ? RB->height - 1 - i : i;
+                uint32_t *dst = &RB->pixels[y * RB->width + dst_x];
+                uint32_t *src = &RB->pixels[(y - dy) * RB->width + src_x];
+                memmove(dst, src, (size_t) w * sizeof(uint32_t));
+        }
+}
+
+void SetRasterClip(RasterBuffer *RB, const SDL_Rect *rect) {
+        SDL_Rect full = { 0, 0, RB->width, RB->height };
+        if (rect == NULL || !SDL_IntersectRect(rect, &full, &RB->clip)) {
+                RB->clip = (rect == NULL) ? full : (SDL_Rect) {0};
+        }
+}
+
+void FreeRasterBuffer(RasterBuffer *RB) {
+        if (RB->texture) {
+                releaseTexture(RB, RB->texture);
+        }
+        free(RB->pixels);
+
+        RB->pixels = NULL;
+        RB->texture = NULL;
+        RB->width = 0;
+        RB->height = 0;
+}
+
+static void WuSpanScalar(RasterBuffer *RB, int x, int x_end, float intery, float gradient, bool steep, SDL_Color color) {
+        for (; x < x_end; x++) {
+                float fy = floorf(intery);
+                int y = (int) fy;
+                float frac = intery - fy;
+
+                if (steep) {
+                        BlendPixel(RB, y, x, color, 1.0f - frac);
+                        BlendPixel(RB, y + 1, x, color, frac);
+                } else {
+                        BlendPixel(RB, x, y, color, 1.0f - frac);
+                        BlendPixel(RB, x, y + 1, color, frac);
+                }
+
+                intery += gradient;
+        }
+}
+
+#ifdef RASTER_X86
+// Blends four ARGB pixels with color (0..255 channels) at alpha a (0..1), straight alpha in and out
+__attribute__((target("sse2")))
+static inline __m128i BlendLanesSSE2(__m128i dst, __m128 a, __m128 cr, __m128 cg, __m128 cb) {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128i byte = _mm_set1_epi32(0xFF);
+
+        __m128 da = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(dst, 24)), _mm_set1_ps(1.0f / 255.0f));
+        __m128 dr = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(dst, 16), byte));
+        __m128 dg = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(dst, 8), byte));
+        __m128 db = _mm_cvtepi32_ps(_mm_and_si128(dst, byte));
+
+        __m128 wd = _mm_mul_ps(da, _mm_sub_ps(one, a));
+        __m128 oa = _mm_add_ps(a, wd);
+        __m128 inv = _mm_div_ps(one, _mm_max_ps(oa, _mm_set1_ps(1e-6f)));
+
+        __m128i r = _mm_cvtps_epi32(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(cr, a), _mm_mul_ps(dr, wd)), inv));
+        __m128i g = _mm_cvtps_epi32(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(cg, a), _mm_mul_ps(dg, wd)), inv));
+        __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(cb, a), _mm_mul_ps(db, wd)), inv));
+        __m128i al = _mm_cvtps_epi32(_mm_mul_ps(oa, _mm_set1_ps(255.0f)));
+
+        return _mm_or_si128(
+                _mm_or_si128(_mm_slli_epi32(al, 24), _mm_slli_epi32(r, 16)),
+                _mm_or_si128(_mm_slli_epi32(g, 8), b)
+        );
+}
+
+// Coverage and blending run four columns at a time; SSE2 has no gather, so the
+// destination pixels are fetched and stored per lane.
+__attribute__((target("sse2")))
+static void WuSpanSSE2(RasterBuffer *RB, int x, int x_end, float intery, float gradient, bool steep, SDL_Color color) {
+        const int W = RB->width;
+        const int row_min = steep ? RB->clip.x : RB->clip.y;
+        const int row_max = steep ? RB->clip.x + RB->clip.w : RB->clip.y + RB->clip.h;
+
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 offsets = _mm_mul_ps(_mm_set_ps(3, 2, 1, 0), _mm_set1_ps(gradient));
+        const __m128 ca = _mm_set1_ps(color.a);
+        const __m128 cr = _mm_set1_ps(color.r), cg = _mm_set1_ps(color.g), cb = _mm_set1_ps(color.b);
+
+        for (; x + 4 <= x_end; x += 4, intery += 4 * gradient) {
+                __m128 fy = _mm_add_ps(_mm_set1_ps(intery), offsets);
+
+                // floor() without SSE4.1: truncate, then step down where truncation rounded up
+                __m128 fl = _mm_cvtepi32_ps(_mm_cvttps_epi32(fy));
+                fl = _mm_sub_ps(fl, _mm_and_ps(_mm_cmpgt_ps(fl, fy), one));
+                __m128 frac = _mm_sub_ps(fy, fl);
+
+                int32_t row[4];
+                _mm_storeu_si128((__m128i *) row, _mm_cvttps_epi32(fl));
+
+                for (int p = 0; p < 2; p++) {
+                        // Truncated to whole alpha steps like BlendPixel, so both paths agree
+                        __m128 a = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(ca, p ? frac : _mm_sub_ps(one, frac))));
+                        a = _mm_mul_ps(a, _mm_set1_ps(1.0f / 255.0f));
+                        int covered = _mm_movemask_ps(_mm_cmpgt_ps(a, _mm_setzero_ps()));
+
+                        int32_t idx[4];
+                        uint32_t px[4] = {0};
+                        for (int i = 0; i < 4; i++) {
+                                int r = row[i] + p;
+                                if (r < row_min || r >= row_max) {
+                                        covered &= ~(1 << i);
+                                        continue;
+                                }
+                                idx[i] = steep ? (x + i) * W + r : r * W + x + i;
+                                px[i] = RB->pixels[idx[i]];
+                        }
+                        if (!covered) {
+                                continue;
+                        }
+
+                        _mm_storeu_si128((__m128i *) px, BlendLanesSSE2(_mm_loadu_si128((__m128i *) px), a, cr, cg, cb));
+                        for (int i = 0; i < 4; i++) {
+                                if (covered & (1 << i)) {
+                                        RB->pixels[idx[i]] = px[i];
+                                }
+                        }
+                }
+        }
+
+        WuSpanScalar(RB, x, x_end, intery, gradient, steep, color);
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256i BlendLanesAVX2(__m256i dst, __m256 a, __m256 cr, __m256 cg, __m256 cb) {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256i byte = _mm256_set1_epi32(0xFF);
+
+        __m256 da = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(dst, 24)), _mm256_set1_ps(1.0f / 255.0f));
+        __m256 dr = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(dst, 16), byte));
+        __m256 dg = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(dst, 8), byte));
+        __m256 db = _mm256_cvtepi32_ps(_mm256_and_si256(dst, byte));
+
+        __m256 wd = _mm256_mul_ps(da, _mm256_sub_ps(one, a));
+        __m256 oa = _mm256_add_ps(a, wd);
+        __m256 inv = _mm256_div_ps(one, _mm256_max_ps(oa, _mm256_set1_ps(1e-6f)));
+
+        __m256i r = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_fmadd_ps(dr, wd, _mm256_mul_ps(cr, a)), inv));
+        __m256i g = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_fmadd_ps(dg, wd, _mm256_mul_ps(cg, a)), inv));
+        __m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_fmadd_ps(db, wd, _mm256_mul_ps(cb, a)), inv));
+        __m256i al = _mm256_cvtps_epi32(_mm256_mul_ps(oa, _mm256_set1_ps(255.0f)));
+
+        return _mm256_or_si256(
+                _mm256_or_si256(_mm256_slli_epi32(al, 24), _mm256_slli_epi32(r, 16)),
+                _mm256_or_si256(_mm256_slli_epi32(g, 8), b)
+        );
+}
+
+// Eight columns per iteration: indices, bounds and coverage are computed in vector
+// registers and destination pixels are gathered; only the stores are per lane.
+__attribute__((target("avx2,fma")))
+static void WuSpanAVX2(RasterBuffer *RB, int x, int x_end, float intery, float gradient, bool steep, SDL_Color color) {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        const __m256 offsets = _mm256_mul_ps(_mm256_cvtepi32_ps(lanes), _mm256_set1_ps(gradient));
+        const __m256i width = _mm256_set1_epi32(RB->width);
+        const __m256i row_min = _mm256_set1_epi32((steep ? RB->clip.x : RB->clip.y) - 1);
+        const __m256i row_max = _mm256_set1_epi32(steep ? RB->clip.x + RB->clip.w : RB->clip.y + RB->clip.h);
+        const __m256i minus_one = _mm256_set1_epi32(-1);
+        const __m256 ca = _mm256_set1_ps(color.a);
+        const __m256 cr = _mm256_set1_ps(color.r), cg = _mm256_set1_ps(color.g), cb = _mm256_set1_ps(color.b);
+
+        for (; x + 8 <= x_end; x += 8, intery += 8 * gradient) {
+                __m256 fy = _mm256_add_ps(_mm256_set1_ps(intery), offsets);
+                __m256 fl = _mm256_floor_ps(fy);
+                __m256 frac = _mm256_sub_ps(fy, fl);
+                __m256i cols = _mm256_add_epi32(_mm256_set1_epi32(x), lanes);
+                __m256i row = _mm256_cvttps_epi32(fl);
+
+                for (int p = 0; p < 2; p++) {
+                        __m256i r = _mm256_sub_epi32(row, p ? minus_one : _mm256_setzero_si256());
+                        __m256 a = _mm256_floor_ps(_mm256_mul_ps(ca, p ? frac : _mm256_sub_ps(one, frac)));
+                        a = _mm256_mul_ps(a, _mm256_set1_ps(1.0f / 255.0f));
+
+                        __m256i valid = _mm256_and_si256(_mm256_cmpgt_epi32(r, row_min), _mm256_cmpgt_epi32(row_max, r));
+                        valid = _mm256_and_si256(valid, _mm256_castps_si256(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ)));
+                        int covered = _mm256_movemask_ps(_mm256_castsi256_ps(valid));
+                        if (!covered) {
+                                continue;
+                        }
+
+                        __m256i idx = steep
+                                ? _mm256_add_epi32(_mm256_mullo_epi32(cols, width), r)
+                                : _mm256_add_epi32(_mm256_mullo_epi32(r, width), cols);
+                        __m256i dst = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *) RB->pixels, idx, valid, 4);
+
+                        int32_t at[8];
+                        uint32_t px[8];
+                        _mm256_storeu_si256((__m256i *) at, idx);
+                        _mm256_storeu_si256((__m256i *) px, BlendLanesAVX2(dst, a, cr, cg, cb));
+                        for (int i = 0; i < 8; i++) {
+                                if (covered & (1 << i)) {
+                                        RB->pixels[at[i]] = px[i];
+                                }
+                        }
+                }
+        }
+
+        WuSpanScalar(RB, x, x_end, intery, gradient, steep, color);
+}
+#endif
+
+static WuSpanKernel wu_kernel = WuSpanScalar;
+
+void InitRasterKernels(void) {
+        wu_kernel = WuSpanScalar;
+
+        #ifdef RASTER_X86
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                        wu_kernel = WuSpanAVX2;
+                } else if (__builtin_cpu_supports("sse2")) {
+                        wu_kernel = WuSpanSSE2;
+                }
+        #endif
+}
+
+void RasterWuSpan(RasterBuffer *RB, int x_start, int x_end, float intery, float gradient, bool steep, SDL_Color color) {
+        // Clip columns to the clip rect so kernels only have to check rows
+        int column_min = steep ? RB->clip.y : RB->clip.x;
+        int column_max = steep ? RB->clip.y + RB->clip.h : RB->clip.x + RB->clip.w;
+        if (x_start < column_min) {
+                intery += gradient * (float) (column_min - x_start);
+                x_start = column_min;
+        }
+        if (x_end > column_max) {
+                x_end = column_max;
+        }
+        if (x_start >= x_end) {
+                return;
+        }
+
+        wu_kernel(RB, x_start, x_end, intery, gradient, steep, color);
+}
+
+// A triangle as the lines x = slope * y + offset its slanted edges lie on, each bounding the
+// inside on one side, its vertical extent and the rows of the clip it spans
+typedef struct {
+        float slope[3], offset[3];
+        int8_t side[3];         // 1: inside is right of the line, -1: left of it, 0: horizontal edge
+        float top, bottom;
+        int y0, y1;
+} TriangleEdges;
+
+// False when the triangle is degenerate or misses the clip's rows
+static bool setupTriangle(const RasterBuffer *RB, SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, TriangleEdges *t) {
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (fabsf(area) < 1e-6f) {
+                return false;
+        }
+        if (area < 0) {
+                SDL_FPoint temp = b; b = c; c = temp;
+        }
+
+        // Counter-clockwise in y-down screen space: each edge has the inside on its left
+        SDL_FPoint v[3] = { a, b, c };
+        for (int i = 0; i < 3; i++) {
+                SDL_FPoint p = v[i], q = v[(i + 1) % 3];
+                float dy = q.y - p.y;
+                t->side[i] = (dy < 0) ? 1 : (dy > 0) ? -1 : 0;
+                t->slope[i] = (dy != 0) ? (q.x - p.x) / dy : 0;
+                t->offset[i] = p.x - t->slope[i] * p.y;
+        }
+
+        t->top = fminf(a.y, fminf(b.y, c.y));
+        t->bottom = fmaxf(a.y, fmaxf(b.y, c.y));
+        t->y0 = (int) floorf(t->top);
+        t->y1 = (int) ceilf(t->bottom);
+        if (t->y0 < RB->clip.y) t->y0 = RB->clip.y;
+        if (t->y1 > RB->clip.y + RB->clip.h - 1) t->y1 = RB->clip.y + RB->clip.h - 1;
+        return t->y0 <= t->y1;
+}
+
+// Where the horizontal line at y crosses the triangle: [*lo, *hi], unclipped. False when it misses.
+static bool triangleInterval(const TriangleEdges *t, float y, float *lo, float *hi) {
+        if (y < t->top || y > t->bottom) {
+                return false;
+        }
+        *lo = -INFINITY;
+        *hi = INFINITY;
+
+        // Every slanted edge bounds the interval on one side
+        for (int i = 0; i < 3; i++) {
+                float x = t->slope[i] * y + t->offset[i];
+                if (t->side[i] > 0) {
+                        *lo = fmaxf(*lo, x);
+                } else if (t->side[i] < 0) {
+                        *hi = fminf(*hi, x);
+                }
+        }
+        return *lo < *hi;
+}
+
+// Aliased fill of the pixels whose centers are inside; only used when the scratch can't be had
+static void fillTriangle(RasterBuffer *RB, SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, SDL_Color color) {
+        TriangleEdges t;
+        if (!setupTriangle(RB, a, b, c, &t)) {
+                return;
+        }
+
+        for (int y = t.y0; y <= t.y1; y++) {
+                float lo, hi;
+                if (!triangleInterval(&t, y + 0.5f, &lo, &hi)) {
+                        continue;
+                }
+
+                int x0 = (int) fmaxf(ceilf(lo - 0.5f), (float) RB->clip.x);
+                int x1 = (int) fminf(floorf(hi - 0.5f), (float) (RB->clip.x + RB->clip.w - 1));
+                for (int x = x0; x <= x1; x++) {
+                        BlendPixel(RB, x, y, color, 1.0f);
+                }
+        }
+}
+
+// Scratch for fills, grown to the largest mesh and clip so far. Per thread: workers fill
+// tiles at the same time.
+static _Thread_local TriangleEdges *FILL_TRIANGLES;
+static _Thread_local uint32_t *FILL_ACTIVE;     // Triangles crossing the current row
+static _Thread_local float *FILL_SPANS;         // lo, hi pairs on the current sub-row
+static _Thread_local float *FILL_RANGES;        // First and last column of each, on every sub-row
+static _Thread_local uint32_t FILL_CAPACITY;    // Triangles all three have room for
+// Coverage of the current row, per clip column: partly covered ends are added straight to
+// it, fully covered runs as a step up and a step down, summed once the row is done
+static _Thread_local float *FILL_COVERAGE;
+static _Thread_local float *FILL_STEPS;
+static _Thread_local int FILL_COLUMNS;
+
+static bool reserveFill(uint32_t triangles, int columns) {
+        if (columns > FILL_COLUMNS) {
+                float *coverage = realloc(FILL_COVERAGE, (size_t) columns * sizeof(float));
+                if (coverage) FILL_COVERAGE = coverage;
+                float *steps = realloc(FILL_STEPS, (size_t) columns * sizeof(float));
+                if (steps) FILL_STEPS = steps;
+                if (!coverage || !steps) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return false;
+                }
+
+                // Kept zeroed between fills
+                for (int x = FILL_COLUMNS; x < columns; x++) {
+                        FILL_COVERAGE[x] = FILL_STEPS[x] = 0;
+                }
+                FILL_COLUMNS = columns;
+        }
+
+        if (triangles <= FILL_CAPACITY) {
+                return true;
+        }
+
+        TriangleEdges *edges = realloc(FILL_TRIANGLES, triangles * sizeof(TriangleEdges));
+        if (edges) FILL_TRIANGLES = edges;
+        uint32_t *active = realloc(FILL_ACTIVE, triangles * sizeof(uint32_t));
+        if (active) FILL_ACTIVE = active;
+        float *spans = realloc(FILL_SPANS, triangles * 2 * sizeof(float));
+        if (spans) FILL_SPANS = spans;
+        float *ranges = realloc(FILL_RANGES, triangles * 2 * FILL_SUBROWS * sizeof(float));
+        if (ranges) FILL_RANGES = ranges;
+        if (!edges || !active || !spans || !ranges) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                return false;
+        }
+
+        FILL_CAPACITY = triangles;
+        return true;
+}
+
+static int compareTriangleRows(const void *a, const void *b) {
+        const TriangleEdges *x = a, *y = b;
+        return (x->y0 > y->y0) - (x->y0 < y->y0);
+}
+
+// Insertion sort of pairs by their first value: a row only crosses a handful of triangles
+static void sortSpans(float *spans, uint32_t count) {
+        for (uint32_t i = 1; i < count; i++) {
+                float lo = spans[2 * i], hi = spans[2 * i + 1];
+                uint32_t j = i;
+                for (; j > 0 && spans[2 * (j - 1)] > lo; j--) {
+                        spans[2 * j] = spans[2 * (j - 1)];
+                        spans[2 * j + 1] = spans[2 * (j - 1) + 1];
+                }
+                spans[2 * j] = lo;
+                spans[2 * j + 1] = hi;
+        }
+}
+
+// Adds `weight` times the part of each column [x, x + 1) that [lo, hi] covers
+// and records the columns it touched in FILL_RANGES
+static void addCoverage(const RasterBuffer *RB, float lo, float hi, float weight, uint32_t *ranges) {
+        lo = fmaxf(lo, (float) RB->clip.x);
+        hi = fminf(hi, (float) (RB->clip.x + RB->clip.w));
+        if (lo >= hi) {
+                return;
+        }
+
+        int x0 = (int) floorf(lo), x1 = (int) ceilf(hi) - 1;
+        float *coverage = FILL_COVERAGE - RB->clip.x, *steps = FILL_STEPS - RB->clip.x;
+        if (x0 == x1) {
+                coverage[x0] += (hi - lo) * weight;
+        } else {
+                coverage[x0] += (x0 + 1 - lo) * weight;
+                coverage[x1] += (hi - x1) * weight;
+                if (x0 + 1 < x1) {
+                        steps[x0 + 1] += weight;
+                        steps[x1] -= weight;
+                }
+        }
+
+        FILL_RANGES[2 * *ranges] = (float) x0;
+        FILL_RANGES[2 * *ranges + 1] = (float) x1;
+        (*ranges)++;
+}
+
+void RasterFillTriangles(RasterBuffer *RB, const SDL_Vertex *vertices, const int *indices, int index_count) {
+        if (index_count < 3 || RB->clip.w <= 0) {
+                return;
+        }
+        SDL_Color color = vertices[indices[0]].color;
+        uint32_t triangles = (uint32_t) index_count / 3;
+
+        if (!reserveFill(triangles, RB->clip.w)) {
+                // Hard edges, and overlaps blend twice, but the stroke is still there
+                for (int i = 0; i + 2 < index_count; i += 3) {
+                        fillTriangle(RB, vertices[indices[i]].position, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position, color);
+                }
+                return;
+        }
+
+        uint32_t count = 0;
+        for (int i = 0; i + 2 < index_count; i += 3) {
+                count += setupTriangle(RB, vertices[indices[i]].position, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position, &FILL_TRIANGLES[count]);
+        }
+        if (count == 0) {
+                return;
+        }
+        qsort(FILL_TRIANGLES, count, sizeof(TriangleEdges), compareTriangleRows);
+
+        int y_end = FILL_TRIANGLES[0].y1;
+        for (uint32_t i = 1; i < count; i++) {
+                if (FILL_TRIANGLES[i].y1 > y_end) y_end = FILL_TRIANGLES[i].y1;
+        }
+
+        // Sweep down the rows. Each sub-row's intervals from every triangle on it are merged, so
+        // the mesh's area is counted once where joins and caps overlap. Coverage is exact across
+        // a row and sampled FILL_SUBROWS times down it; each pixel is then blended once, by it.
+        const float weight = 1.0f / FILL_SUBROWS;
+        uint32_t next = 0, active = 0;
+        for (int y = FILL_TRIANGLES[0].y0; y <= y_end; y++) {
+                while (next < count && FILL_TRIANGLES[next].y0 <= y) {
+                        FILL_ACTIVE[active++] = next++;
+                }
+
+                uint32_t kept = 0;
+                for (uint32_t i = 0; i < active; i++) {
+                        if (FILL_TRIANGLES[FILL_ACTIVE[i]].y1 >= y) {
+                                FILL_ACTIVE[kept++] = FILL_ACTIVE[i];
+                        }
+                }
+                active = kept;
+
+                uint32_t ranges = 0;
+                for (int sub = 0; sub < FILL_SUBROWS; sub++) {
+                        float yc = y + (sub + 0.5f) * weight;
+
+                        uint32_t spans = 0;
+                        for (uint32_t i = 0; i < active; i++) {
+                                float lo, hi;
+                                if (triangleInterval(&FILL_TRIANGLES[FILL_ACTIVE[i]], yc, &lo, &hi)) {
+                                        FILL_SPANS[2 * spans] = lo;
+                                        FILL_SPANS[2 * spans + 1] = hi;
+                                        spans++;
+                                }
+                        }
+                        if (spans == 0) {
+                                continue;
+                        }
+
+                        sortSpans(FILL_SPANS, spans);
+                        float lo = FILL_SPANS[0], hi = FILL_SPANS[1];
+                        for (uint32_t i = 1; i < spans; i++) {
+                                if (FILL_SPANS[2 * i] <= hi) {
+                                        hi = fmaxf(hi, FILL_SPANS[2 * i + 1]);
+                                        continue;
+                                }
+                                addCoverage(RB, lo, hi, weight, &ranges);
+                                lo = FILL_SPANS[2 * i];
+                                hi = FILL_SPANS[2 * i + 1];
+                        }
+                        addCoverage(RB, lo, hi, weight, &ranges);
+                }
+
+                if (ranges == 0) {
+                        continue;
+                }
+
+                // Only the columns something touched are visited, each once
+                sortSpans(FILL_RANGES, ranges);
+                float *coverage = FILL_COVERAGE - RB->clip.x, *steps = FILL_STEPS - RB->clip.x;
+                int x = (int) FILL_RANGES[0];
+                float run = 0;
+                for (uint32_t i = 0; i < ranges; i++) {
+                        int x_end = (int) FILL_RANGES[2 * i + 1];
+                        if (x < (int) FILL_RANGES[2 * i]) {
+                                x = (int) FILL_RANGES[2 * i];
+                        }
+                        for (; x <= x_end; x++) {
+                                run += steps[x];
+                                BlendPixel(RB, x, y, color, coverage[x] + run);
+                                coverage[x] = steps[x] = 0;
+                        }
+                }
+        }
+}
+
+void FreeRasterScratch(void) {
+        free(FILL_TRIANGLES);
+        free(FILL_ACTIVE);
+        free(FILL_SPANS);
+        free(FILL_RANGES);
+        free(FILL_COVERAGE);
+        free(FILL_STEPS);
+        FILL_TRIANGLES = NULL;
+        FILL_ACTIVE = NULL;
+        FILL_SPANS = NULL;
+        FILL_RANGES = NULL;
+        FILL_CAPACITY = 0;
+        FILL_COVERAGE = NULL;
+        FILL_STEPS = NULL;
+        FILL_COLUMNS = 0;
+}
+
+#undef FILL_SUBROWS
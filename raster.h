@@ -0,0 +1,92 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_render.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "texpool.h"
+
+#pragma once
+
+// CPU side ARGB8888 canvas. Lines are blended straight into `pixels` and
+// uploaded to `texture` once per frame, whole or by rect.
+typedef struct {
+        uint32_t *pixels;       // width * height, pitch == width
+        SDL_Texture *texture;   // Streaming texture, same size as pixels
+        int width, height;
+        SDL_Rect clip;          // Nothing is drawn outside this, always inside the buffer
+        TexturePool *pool;      // Optional: textures are recycled through it when set
+} RasterBuffer;
+
+// `pool` may be NULL; when set, the first texture already comes from it
+int CreateRasterBuffer(RasterBuffer *RB, SDL_Renderer *renderer, int width, int height, TexturePool *pool);
+// Keeps the pixels the old and new sizes share (anchored top-left); the rest is undefined
+int ResizeRasterBuffer(RasterBuffer *RB, SDL_Renderer *renderer, int width, int height);
+void ClearRasterBuffer(RasterBuffer *RB, SDL_Color color);
+void ClearRasterRect(RasterBuffer *RB, SDL_Rect rect, SDL_Color color);
+void UploadRasterBuffer(RasterBuffer *RB);
+void UploadRasterRect(RasterBuffer *RB, SDL_Rect rect);
+// Moves the contents by (dx, dy); the uncovered strips keep stale pixels
+void ScrollRasterBuffer(RasterBuffer *RB, int dx, int dy);
+// NULL resets the clip to the whole buffer
+void SetRasterClip(RasterBuffer *RB, const SDL_Rect *rect);
+void FreeRasterBuffer(RasterBuffer *RB);
+
+// Picks the fastest Wu span kernel this CPU supports (AVX2, SSE2 or scalar)
+void InitRasterKernels(void);
+// Interior columns [x_start, x_end) of a Wu line: column x covers rows floor(intery) and
+// floor(intery) + 1, intery advancing by gradient per column. Steep lines have x/y swapped.
+void RasterWuSpan(RasterBuffer *RB, int x_start, int x_end, float intery, float gradient, bool steep, SDL_Color color);
+
+// Anti-aliased fill of an indexed triangle list in the color of its first vertex. Each pixel is
+// blended once, by how much of it the union of the triangles covers, so a translucent mesh
+// blends evenly and its outline needs no separate edge pass.
+void RasterFillTriangles(RasterBuffer *RB, const SDL_Vertex *vertices, const int *indices, int index_count);
+void FreeRasterScratch(void);
+
+static inline uint32_t PackColor(SDL_Color color) {
+        return ((uint32_t) color.a << 24) | ((uint32_t) color.r << 16) | ((uint32_t) color.g << 8) | (uint32_t) color.b;
+}
+
+// Source-over blend of `color` (straight alpha) scaled by `intensity` into pixel (x, y)
+static inline void BlendPixel(RasterBuffer *RB, int x, int y, SDL_Color color, float intensity) {
+        if ((unsigned) (x - RB->clip.x) >= (unsigned) RB->clip.w || (unsigned) (y - RB->clip.y) >= (unsigned) RB->clip.h) {
+                return;
+        }
+
+        // Wu endpoint weights can stray outside [0, 1]
+        intensity = (intensity < 0.0f) ? 0.0f : (intensity > 1.0f) ? 1.0f : intensity;
+        uint32_t a = (uint32_t) (color.a * intensity);
+        if (a == 0) {
+                return;
+        }
+
+        uint32_t *dst = &RB->pixels[y * RB->width + x];
+        if (a >= 255) {
+                *dst = PackColor(color) | 0xFF000000u;
+                return;
+        }
+
+        uint32_t d = *dst;
+        uint32_t da = d >> 24, dr = (d >> 16) & 0xFF, dg = (d >> 8) & 0xFF, db = d & 0xFF;
+        uint32_t ia = 255 - a;
+
+        if (da == 255) {
+                // Opaque destination (the common case): plain lerp
+                dr = (color.r * a + dr * ia + 127) / 255;
+                dg = (color.g * a + dg * ia + 127) / 255;
+                db = (color.b * a + db * ia + 127) / 255;
+        } else {
+                // Translucent destination: keep result in straight alpha so it can be
+                // composited with SDL_BLENDMODE_BLEND afterwards
+                uint32_t wd = da * ia / 255;
+                uint32_t oa = a + wd;
+                dr = (color.r * a + dr * wd) / oa;
+                dg = (color.g * a + dg * wd) / oa;
+                db = (color.b * a + db * wd) / oa;
+                da = oa;
+        }
+
+        *dst = (da << 24) | (dr << 16) | (dg << 8) | db;
+}
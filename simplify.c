@@ -0,0 +1,318 @@
+#include "simplify.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+        #include <immintrin.h>
+        #define SIMPLIFY_X86
+#endif
+
+// Distance from (px, py) to the line through (ax, ay) and (bx, by)
+static double perpendicularDistance(float px, float py, float ax, float ay, float bx, float by) {
+        double dx = bx - ax;
+        double dy = by - ay;
+
+        if (dx == 0 && dy == 0) {
+                dx = px - ax;
+                dy = py - ay;
+                return sqrt(dx * dx + dy * dy);
+        }
+
+        double num = fabs(dy * px - dx * py + bx * ay - by * ax);
+        double den = sqrt(dx * dx + dy * dy);
+        return num / den;
+}
+
+float SimplifyEpsilon(const PointStore *points, uint32_t start, uint32_t end) {
+        Point first = LoadPoint(points, start), last = LoadPoint(points, end);
+        double total = 0, squares = 0;
+        uint32_t valid = 0;
+
+        // One pass: sum(d - mean)^2 = sum(d^2) - 2 mean sum(d) + valid mean^2
+        for (uint32_t i = start + 1; i < end;) {
+                PointChunk *chunk;
+                uint32_t offset;
+                uint32_t n = PointRun(points, i, end - 1, &chunk, &offset);
+
+                for (uint32_t k = offset; k < offset + n; k++) {
+                        double d = perpendicularDistance(chunk->x[k], chunk->y[k], first.x, first.y, last.x, last.y);
+                        total += d;
+                        squares += d * d;
+                        valid++;
+                }
+                i += n;
+        }
+
+        double mean = (valid > 0) ? (total / valid) : 0;
+        double spread = fmax(0, squares - 2 * mean * total + valid * mean * mean);
+
+        double stddev = sqrt(spread / (end - start + 1));
+        return (float) (stddev * 2e-3);
+}
+
+// Index in [0, n) of the point farthest from the line through (ax, ay) with direction (dx, dy),
+// measured as |cross product| (the distance times the chord length). Only points beating *best
+// count: it is raised to theirs, and n is returned when there are none. Ties keep the first.
+typedef uint32_t (*FarthestKernel)(const float *x, const float *y, uint32_t n, float ax, float ay, float dx, float dy, float *best);
+
+static uint32_t FarthestScalar(const float *x, const float *y, uint32_t n, float ax, float ay, float dx, float dy, float *best) {
+        uint32_t index = n;
+        for (uint32_t i = 0; i < n; i++) {
+                float d = fabsf(dy * (x[i] - ax) - dx * (y[i] - ay));
+                if (d > *best) {
+                        *best = d;
+                        index = i;
+                }
+        }
+        return index;
+}
+
+// Picks the best of the per-lane winners (lowest index among equals), then finishes the tail
+static uint32_t reduceLanes(const float *lanes, const int32_t *ids, int count, uint32_t i, const float *x, const float *y, uint32_t n, float ax, float ay, float dx, float dy, float *best) {
+        uint32_t index = n;
+        for (int l = 0; l < count; l++) {
+                if (ids[l] < 0) continue;
+                if (lanes[l] > *best || (lanes[l] == *best && (uint32_t) ids[l] < index)) {
+                        *best = lanes[l];
+                        index = (uint32_t) ids[l];
+                }
+        }
+
+        uint32_t tail = FarthestScalar(x + i, y + i, n - i, ax, ay, dx, dy, best);
+        return (tail < n - i) ? i + tail : index;
+}
+
+#ifdef SIMPLIFY_X86
+__attribute__((target("sse2")))
+static uint32_t FarthestSSE2(const float *x, const float *y, uint32_t n, float ax, float ay, float dx, float dy, float *best) {
+        const __m128 vax = _mm_set1_ps(ax), vay = _mm_set1_ps(ay);
+        const __m128 vdx = _mm_set1_ps(dx), vdy = _mm_set1_ps(dy);
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        const __m128i step = _mm_set1_epi32(4);
+
+        __m128 top = _mm_set1_ps(*best);
+        __m128i top_index = _mm_set1_epi32(-1);
+        __m128i index = _mm_set_epi32(3, 2, 1, 0);
+
+        uint32_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+                __m128 px = _mm_sub_ps(_mm_loadu_ps(x + i), vax);
+                __m128 py = _mm_sub_ps(_mm_loadu_ps(y + i), vay);
+                __m128 d = _mm_andnot_ps(sign, _mm_sub_ps(_mm_mul_ps(vdy, px), _mm_mul_ps(vdx, py)));
+
+                __m128i better = _mm_castps_si128(_mm_cmpgt_ps(d, top));
+                top = _mm_max_ps(top, d);
+                top_index = _mm_or_si128(_mm_and_si128(better, index), _mm_andnot_si128(better, top_index));
+                index = _mm_add_epi32(index, step);
+        }
+
+        float lanes[4];
+        int32_t ids[4];
+        _mm_storeu_ps(lanes, top);
+        _mm_storeu_si128((__m128i *) ids, top_index);
+        return reduceLanes(lanes, ids, 4, i, x, y, n, ax, ay, dx, dy, best);
+}
+
+__attribute__((target("avx2")))
+static uint32_t FarthestAVX2(const float *x, const float *y, uint32_t n, float ax, float ay, float dx, float dy, float *best) {
+        const __m256 vax = _mm256_set1_ps(ax), vay = _mm256_set1_ps(ay);
+        const __m256 vdx = _mm256_set1_ps(dx), vdy = _mm256_set1_ps(dy);
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        const __m256i step = _mm256_set1_epi32(8);
+
+        __m256 top = _mm256_set1_ps(*best);
+        __m256 top_index = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        __m256i index = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+        uint32_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+                __m256 px = _mm256_sub_ps(_mm256_loadu_ps(x + i), vax);
+                __m256 py = _mm256_sub_ps(_mm256_loadu_ps(y + i), vay);
+                __m256 d = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_mul_ps(vdy, px), _mm256_mul_ps(vdx, py)));
+
+                __m256 better = _mm256_cmp_ps(d, top, _CMP_GT_OQ);
+                top = _mm256_max_ps(top, d);
+                top_index = _mm256_blendv_ps(top_index, _mm256_castsi256_ps(index), better);
+                index = _mm256_add_epi32(index, step);
+        }
+
+        float lanes[8];
+        int32_t ids[8];
+        _mm256_storeu_ps(lanes, top);
+        _mm256_storeu_si256((__m256i *) ids, _mm256_castps_si256(top_index));
+        return reduceLanes(lanes, ids, 8, i, x, y, n, ax, ay, dx, dy, best);
+}
+#endif
+
+static FarthestKernel farthest_kernel = FarthestScalar;
+
+void InitSimplifyKernels(void) {
+        farthest_kernel = FarthestScalar;
+
+        #ifdef SIMPLIFY_X86
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx2")) {
+                        farthest_kernel = FarthestAVX2;
+                } else if (__builtin_cpu_supports("sse2")) {
+                        farthest_kernel = FarthestSSE2;
+                }
+        #endif
+}
+
+// Farthest of points (start, end) from the chord start-end; returns start when none is off it
+static uint32_t farthestPoint(const PointStore *points, uint32_t start, uint32_t end, double *distance) {
+        Point a = LoadPoint(points, start), b = LoadPoint(points, end);
+        float dx = b.x - a.x, dy = b.y - a.y;
+        uint32_t index = start;
+        *distance = 0;
+
+        if (dx == 0 && dy == 0) {
+                // Closed chord: plain distance from the shared endpoint
+                for (uint32_t i = start + 1; i < end; i++) {
+                        Point p = LoadPoint(points, i);
+                        double d = hypot(p.x - a.x, p.y - a.y);
+                        if (d > *distance) {
+                                *distance = d;
+                                index = i;
+                        }
+                }
+                return index;
+        }
+
+        float best = 0;
+        for (uint32_t i = start + 1; i < end;) {
+                PointChunk *chunk;
+                uint32_t offset;
+                uint32_t n = PointRun(points, i, end - 1, &chunk, &offset);
+
+                uint32_t found = farthest_kernel(chunk->x + offset, chunk->y + offset, n, a.x, a.y, dx, dy, &best);
+                if (found < n) {
+                        index = i + found;
+                }
+                i += n;
+        }
+
+        *distance = best / sqrt((double) dx * dx + (double) dy * dy);
+        return index;
+}
+
+// Grown to the longest stroke simplified so far
+static uint32_t *STACK;         // (start, end) pairs still to split
+static uint32_t STACK_CAPACITY;
+static bool *KEEP;
+static uint32_t KEEP_CAPACITY;
+
+static bool reserveScratch(uint32_t count) {
+        if (count > KEEP_CAPACITY) {
+                bool *temp = realloc(KEEP, count * sizeof(bool));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return false;
+                }
+                KEEP = temp;
+                KEEP_CAPACITY = count;
+        }
+
+        // Every pushed range splits a longer one, so there are never more than `count` pairs
+        if (count * 2 > STACK_CAPACITY) {
+                uint32_t *temp = realloc(STACK, count * 2 * sizeof(uint32_t));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return false;
+                }
+                STACK = temp;
+                STACK_CAPACITY = count * 2;
+        }
+
+        return true;
+}
+
+uint32_t SimplifyRange(PointStore *points, uint32_t start, uint32_t end, float epsilon) {
+        uint32_t count = end - start + 1;
+        if (count <= 2 || !reserveScratch(count)) {
+                return count;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                KEEP[i] = false;
+        }
+        KEEP[0] = KEEP[count - 1] = true;
+
+        uint32_t top = 0;
+        STACK[top++] = start;
+        STACK[top++] = end;
+
+        while (top > 0) {
+                uint32_t e = STACK[--top];
+                uint32_t s = STACK[--top];
+                if (e <= s + 1) {
+                        continue;
+                }
+
+                double distance;
+                uint32_t index = farthestPoint(points, s, e, &distance);
+
+                // index == s: nothing lies off the chord (a zero epsilon would loop forever)
+                if (index != s && distance >= epsilon) {
+                        KEEP[index - start] = true;
+                        STACK[top++] = s;
+                        STACK[top++] = index;
+                        STACK[top++] = index;
+                        STACK[top++] = e;
+                }
+        }
+
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < count; i++) {
+                if (KEEP[i]) {
+                        StorePoint(points, start + kept, LoadPoint(points, start + i));
+                        kept++;
+                }
+        }
+
+        return kept;
+}
+
+// Distance from (px, py) to the segment a-b
+static float segmentDistance(float px, float py, Point a, Point b) {
+        float dx = b.x - a.x, dy = b.y - a.y;
+        float len2 = dx * dx + dy * dy;
+        float t = (len2 > 0) ? ((px - a.x) * dx + (py - a.y) * dy) / len2 : 0;
+        t = fmaxf(0, fminf(1, t));
+        return hypotf(px - (a.x + t * dx), py - (a.y + t * dy));
+}
+
+int StreamAppend(StreamWindow *window, PointStore *points, uint32_t start, Point p) {
+        if (points->count >= start + 2 && window->count < STREAM_WINDOW) {
+                Point anchor = LoadPoint(points, points->count - 2);
+                Point tail = LoadPoint(points, points->count - 1);
+
+                bool redundant = tail.connected_to_next_point && tail.line_thickness == p.line_thickness &&
+                        segmentDistance(tail.x, tail.y, anchor, p) <= STREAM_TOLERANCE;
+                for (uint32_t i = 0; redundant && i < window->count; i++) {
+                        redundant = segmentDistance(window->x[i], window->y[i], anchor, p) <= STREAM_TOLERANCE;
+                }
+
+                if (redundant) {
+                        window->x[window->count] = tail.x;
+                        window->y[window->count] = tail.y;
+                        window->count++;
+                        StorePoint(points, points->count - 1, p);
+                        return 0;
+                }
+        }
+
+        // The previous point stays: it is the new anchor
+        window->count = 0;
+        return AppendPoint(points, p);
+}
+
+void FreeSimplifyScratch(void) {
+        free(STACK);
+        free(KEEP);
+        STACK = NULL;
+        KEEP = NULL;
+        STACK_CAPACITY = KEEP_CAPACITY = 0;
+}
@@ -0,0 +1,33 @@
+#include <stdint.h>
+
+#include "pointstore.h"
+
+#pragma once
+
+#define STREAM_TOLERANCE 0.25f  // Max distance (px) of a dropped sample from the kept polyline
+#define STREAM_WINDOW 32        // Most samples dropped between two kept points
+
+// Samples dropped since the last kept point of the live stroke, so a new chord can be
+// checked against all of them
+typedef struct {
+        float x[STREAM_WINDOW], y[STREAM_WINDOW];
+        uint32_t count;
+} StreamWindow;
+
+// Picks the farthest-point kernel for this CPU; scalar until called
+void InitSimplifyKernels(void);
+
+// Douglas-Peucker tolerance for points [start, end], from the spread of their distances
+float SimplifyEpsilon(const PointStore *points, uint32_t start, uint32_t end);
+
+// Douglas-Peucker over points [start, end] with an explicit stack. The kept points are moved
+// down to [start, start + kept); returns kept. Scratch is reused between calls and only
+// grows when a longer stroke comes along.
+uint32_t SimplifyRange(PointStore *points, uint32_t start, uint32_t end, float epsilon);
+void FreeSimplifyScratch(void);
+
+// Appends p to the live stroke, which holds points [start, count) of the store. If the previous
+// point and every sample dropped before it stay within STREAM_TOLERANCE of the chord from the
+// last kept point to p, the previous point is dropped and p takes its place. Returns 1 when p
+// could not be stored.
+int StreamAppend(StreamWindow *window, PointStore *points, uint32_t start, Point p);
@@ -0,0 +1,209 @@
+#include "spatial.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint32_t hashCell(int32_t cx, int32_t cy) {
+        uint32_t h = (uint32_t) cx * 0x9E3779B1u ^ (uint32_t) cy * 0x85EBCA77u;
+        return h ^ (h >> 15);
+}
+
+static GridCell* findCell(SpatialIndex *index, int32_t cx, int32_t cy) {
+        if (index->cellCapacity == 0) {
+                return NULL;
+        }
+
+        uint32_t mask = index->cellCapacity - 1;
+        for (uint32_t i = hashCell(cx, cy) & mask;; i = (i + 1) & mask) {
+                GridCell *cell = &index->cells[i];
+                if (!cell->used) return NULL;
+                if (cell->cx == cx && cell->cy == cy) return cell;
+        }
+}
+
+static int growCells(SpatialIndex *index) {
+        uint32_t new_capacity = (index->cellCapacity == 0) ? 64 : index->cellCapacity << 1;
+        GridCell *cells = calloc(new_capacity, sizeof(GridCell));
+        if (!cells) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                return 1;
+        }
+
+        for (uint32_t i = 0; i < index->cellCapacity; i++) {
+                GridCell *old = &index->cells[i];
+                if (!old->used) continue;
+
+                uint32_t j = hashCell(old->cx, old->cy) & (new_capacity - 1);
+                while (cells[j].used) j = (j + 1) & (new_capacity - 1);
+                cells[j] = *old;
+        }
+
+        free(index->cells);
+        index->cells = cells;
+        index->cellCapacity = new_capacity;
+        return 0;
+}
+
+static GridCell* getCell(SpatialIndex *index, int32_t cx, int32_t cy) {
+        GridCell *cell = findCell(index, cx, cy);
+        if (cell) {
+                return cell;
+        }
+
+        // Keep load under 70%
+        if ((index->cellCount + 1) * 10 > index->cellCapacity * 7 && growCells(index) != 0) {
+                return NULL;
+        }
+
+        uint32_t mask = index->cellCapacity - 1;
+        uint32_t i = hashCell(cx, cy) & mask;
+        while (index->cells[i].used) i = (i + 1) & mask;
+
+        index->cells[i] = (GridCell) { .cx = cx, .cy = cy, .used = true };
+        index->cellCount++;
+        return &index->cells[i];
+}
+
+static void cellRange(Bounds b, int32_t *cx0, int32_t *cy0, int32_t *cx1, int32_t *cy1) {
+        *cx0 = (int32_t) floorf(b.x0 / GRID_CELL_SIZE);
+        *cy0 = (int32_t) floorf(b.y0 / GRID_CELL_SIZE);
+        *cx1 = (int32_t) floorf(b.x1 / GRID_CELL_SIZE);
+        *cy1 = (int32_t) floorf(b.y1 / GRID_CELL_SIZE);
+}
+
+int SpatialInsert(SpatialIndex *index, uint32_t id, Bounds bounds) {
+        if (id >= index->stampCapacity) {
+                uint32_t new_capacity = (index->stampCapacity == 0) ? 256 : index->stampCapacity;
+                while (new_capacity <= id) new_capacity <<= 1;
+
+                uint32_t *temp = realloc(index->stamps, new_capacity * sizeof(uint32_t));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return 1;
+                }
+                memset(temp + index->stampCapacity, 0, (new_capacity - index->stampCapacity) * sizeof(uint32_t));
+                index->stamps = temp;
+                index->stampCapacity = new_capacity;
+        }
+
+        int32_t cx0, cy0, cx1, cy1;
+        cellRange(bounds, &cx0, &cy0, &cx1, &cy1);
+
+        for (int32_t cy = cy0; cy <= cy1; cy++) {
+                for (int32_t cx = cx0; cx <= cx1; cx++) {
+                        GridCell *cell = getCell(index, cx, cy);
+                        if (!cell) {
+                                return 1;
+                        }
+
+                        if (cell->count >= cell->capacity) {
+                                uint32_t new_capacity = (cell->capacity == 0) ? 4 : cell->capacity << 1;
+                                uint32_t *temp = realloc(cell->ids, new_capacity * sizeof(uint32_t));
+                                if (!temp) {
+                                        fprintf(stderr, "Memory allocation failed!\n");
+                                        return 1;
+                                }
+                                cell->ids = temp;
+                                cell->capacity = new_capacity;
+                        }
+                        cell->ids[cell->count++] = id;
+                }
+        }
+
+        return 0;
+}
+
+void SpatialRemove(SpatialIndex *index, uint32_t id, Bounds bounds) {
+        int32_t cx0, cy0, cx1, cy1;
+        cellRange(bounds, &cx0, &cy0, &cx1, &cy1);
+
+        for (int32_t cy = cy0; cy <= cy1; cy++) {
+                for (int32_t cx = cx0; cx <= cx1; cx++) {
+                        GridCell *cell = findCell(index, cx, cy);
+                        if (!cell) continue;
+
+                        for (uint32_t i = 0; i < cell->count; i++) {
+                                if (cell->ids[i] == id) {
+                                        cell->ids[i] = cell->ids[--cell->count];
+                                        break;
+                                }
+                        }
+                }
+        }
+}
+
+static int compareIds(const void *a, const void *b) {
+        uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+        return (x > y) - (x < y);
+}
+
+static void collectCell(SpatialIndex *index, GridCell *cell, uint32_t *count) {
+        for (uint32_t i = 0; i < cell->count; i++) {
+                uint32_t id = cell->ids[i];
+                if (index->stamps[id] == index->generation) continue;
+                index->stamps[id] = index->generation;
+
+                if (*count >= index->resultCapacity) {
+                        uint32_t new_capacity = (index->resultCapacity == 0) ? 256 : index->resultCapacity << 1;
+                        uint32_t *temp = realloc(index->results, new_capacity * sizeof(uint32_t));
+                        if (!temp) {
+                                fprintf(stderr, "Memory allocation failed!\n");
+                                return;
+                        }
+                        index->results = temp;
+                        index->resultCapacity = new_capacity;
+                }
+                index->results[(*count)++] = id;
+        }
+}
+
+uint32_t SpatialQuery(SpatialIndex *index, Bounds area, const uint32_t **ids) {
+        uint32_t count = 0;
+        *ids = index->results;
+
+        if (index->cellCount == 0) {
+                return 0;
+        }
+
+        if (++index->generation == 0) {
+                // Stamps wrapped around: start over
+                memset(index->stamps, 0, index->stampCapacity * sizeof(uint32_t));
+                index->generation = 1;
+        }
+
+        int32_t cx0, cy0, cx1, cy1;
+        cellRange(area, &cx0, &cy0, &cx1, &cy1);
+        double span = ((double) cx1 - cx0 + 1) * ((double) cy1 - cy0 + 1);
+
+        if (span > index->cellCount) {
+                // Huge area (zoomed out): cheaper to walk the occupied cells
+                for (uint32_t i = 0; i < index->cellCapacity; i++) {
+                        GridCell *cell = &index->cells[i];
+                        if (cell->used && cell->cx >= cx0 && cell->cx <= cx1 && cell->cy >= cy0 && cell->cy <= cy1) {
+                                collectCell(index, cell, &count);
+                        }
+                }
+        } else {
+                for (int32_t cy = cy0; cy <= cy1; cy++) {
+                        for (int32_t cx = cx0; cx <= cx1; cx++) {
+                                GridCell *cell = findCell(index, cx, cy);
+                                if (cell) collectCell(index, cell, &count);
+                        }
+                }
+        }
+
+        qsort(index->results, count, sizeof(uint32_t), compareIds);
+        *ids = index->results;
+        return count;
+}
+
+void FreeSpatialIndex(SpatialIndex *index) {
+        for (uint32_t i = 0; i < index->cellCapacity; i++) {
+                free(index->cells[i].ids);
+        }
+        free(index->cells);
+        free(index->results);
+        free(index->stamps);
+        *index = (SpatialIndex) {0};
+}
@@ -0,0 +1,41 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+// World-space axis aligned box, padded for stroke width and anti-aliasing
+typedef struct {
+        float x0, y0, x1, y1;
+} Bounds;
+
+#define GRID_CELL_SIZE 256.0f   // World units per grid cell side
+
+typedef struct {
+        int32_t cx, cy;
+        uint32_t *ids;          // Strokes whose bounds overlap this cell
+        uint32_t count, capacity;
+        bool used;
+} GridCell;
+
+// Uniform grid over the (unbounded) world, stored as an open addressing hash of cells.
+// Maps world rects to the ids of strokes whose bounds overlap them.
+typedef struct {
+        GridCell *cells;
+        uint32_t cellCapacity;  // Power of two
+        uint32_t cellCount;
+
+        // Query scratch: results, and a per-id stamp so each id is reported once
+        uint32_t *results;
+        uint32_t resultCapacity;
+        uint32_t *stamps;
+        uint32_t stampCapacity;
+        uint32_t generation;
+} SpatialIndex;
+
+int SpatialInsert(SpatialIndex *index, uint32_t id, Bounds bounds);
+// `bounds` must be the ones the id was inserted with
+void SpatialRemove(SpatialIndex *index, uint32_t id, Bounds bounds);
+// Ids overlapping `area` in ascending order; the array belongs to the index and is
+// valid until the next query
+uint32_t SpatialQuery(SpatialIndex *index, Bounds area, const uint32_t **ids);
+void FreeSpatialIndex(SpatialIndex *index);
@@ -0,0 +1,276 @@
+#include "stroke.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MITER_LIMIT 4.0f
+#define ARC_TOLERANCE 0.25f     // Max distance (px) between an arc and its chords
+
+int pushPolylinePoint(Polyline *line, float x, float y, float w) {
+        if (line->count >= line->capacity) {
+                uint32_t new_capacity = (line->capacity == 0) ? 256 : line->capacity << 1;
+
+                FlatPoint *temp = realloc(line->points, new_capacity * sizeof(FlatPoint));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return 1;
+                }
+                line->points = temp;
+                line->capacity = new_capacity;
+        }
+
+        line->points[line->count++] = (FlatPoint) { x, y, w };
+        return 0;
+}
+
+void FreePolyline(Polyline *line) {
+        free(line->points);
+        *line = (Polyline) {0};
+}
+
+static int reserveMesh(StrokeMesh *mesh, uint32_t vertices, uint32_t indices) {
+        if (mesh->vertexCount + vertices > mesh->vertexCapacity) {
+                uint32_t new_capacity = (mesh->vertexCapacity == 0) ? 1024 : mesh->vertexCapacity;
+                while (new_capacity < mesh->vertexCount + vertices) new_capacity <<= 1;
+
+                SDL_Vertex *temp = realloc(mesh->vertices, new_capacity * sizeof(SDL_Vertex));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return 1;
+                }
+                mesh->vertices = temp;
+                mesh->vertexCapacity = new_capacity;
+        }
+
+        if (mesh->indexCount + indices > mesh->indexCapacity) {
+                uint32_t new_capacity = (mesh->indexCapacity == 0) ? 2048 : mesh->indexCapacity;
+                while (new_capacity < mesh->indexCount + indices) new_capacity <<= 1;
+
+                int *temp = realloc(mesh->indices, new_capacity * sizeof(int));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return 1;
+                }
+                mesh->indices = temp;
+                mesh->indexCapacity = new_capacity;
+        }
+
+        return 0;
+}
+
+static inline int addVertex(StrokeMesh *mesh, float x, float y, SDL_Color color) {
+        mesh->vertices[mesh->vertexCount] = (SDL_Vertex) { .position = { x, y }, .color = color };
+        return (int) mesh->vertexCount++;
+}
+
+static inline void addTriangle(StrokeMesh *mesh, int a, int b, int c) {
+        mesh->indices[mesh->indexCount++] = a;
+        mesh->indices[mesh->indexCount++] = b;
+        mesh->indices[mesh->indexCount++] = c;
+}
+
+static inline SDL_Color clearColor(SDL_Color color) {
+        return (SDL_Color) { color.r, color.g, color.b, 0 };
+}
+
+// Radius the mesh's solid part is built at: the core when a fringe goes around it, else the whole half width
+static inline float meshRadius(float w, float fringe) {
+        return (fringe > 0) ? StrokeCoreRadius(w) : w * 0.5f;
+}
+
+// Band `fringe` wide on the outside of edge a-b (existing vertices), fading out along (nx, ny)
+static int addFringe(StrokeMesh *mesh, int a, int b, float nx, float ny, float fringe, SDL_Color color) {
+        if (reserveMesh(mesh, 2, 6) != 0) {
+                return 1;
+        }
+
+        SDL_FPoint pa = mesh->vertices[a].position, pb = mesh->vertices[b].position;
+        int oa = addVertex(mesh, pa.x + nx * fringe, pa.y + ny * fringe, clearColor(color));
+        int ob = addVertex(mesh, pb.x + nx * fringe, pb.y + ny * fringe, clearColor(color));
+        addTriangle(mesh, a, oa, b);
+        addTriangle(mesh, b, oa, ob);
+        return 0;
+}
+
+// Fills the gap at vertex v between two fringes fading out along (nx0, ny0) and (nx1, ny1)
+static int addFringeWedge(StrokeMesh *mesh, int v, float nx0, float ny0, float nx1, float ny1, float fringe, SDL_Color color) {
+        if (reserveMesh(mesh, 2, 3) != 0) {
+                return 1;
+        }
+
+        SDL_FPoint p = mesh->vertices[v].position;
+        int o0 = addVertex(mesh, p.x + nx0 * fringe, p.y + ny0 * fringe, clearColor(color));
+        int o1 = addVertex(mesh, p.x + nx1 * fringe, p.y + ny1 * fringe, clearColor(color));
+        addTriangle(mesh, v, o0, o1);
+        return 0;
+}
+
+// Fan around (cx, cy) from `angle` sweeping `sweep` radians, ringed by a fringe when it's > 0
+static int addArc(StrokeMesh *mesh, float cx, float cy, float radius, float angle, float sweep, float fringe, SDL_Color color) {
+        float step = (radius + fringe > ARC_TOLERANCE) ? 2.0f * acosf(1.0f - ARC_TOLERANCE / (radius + fringe)) : (float) M_PI;
+        int steps = (int) ceilf(fabsf(sweep) / step);
+        if (steps < 1) steps = 1;
+
+        bool ring = fringe > 0;
+        if (reserveMesh(mesh, (steps + 1) * (ring ? 2 : 1) + 1, steps * (ring ? 9 : 3)) != 0) {
+                return 1;
+        }
+
+        float outer = radius + fringe;
+        int center = addVertex(mesh, cx, cy, color);
+        int prev = addVertex(mesh, cx + cosf(angle) * radius, cy + sinf(angle) * radius, color);
+        int prev_outer = ring ? addVertex(mesh, cx + cosf(angle) * outer, cy + sinf(angle) * outer, clearColor(color)) : 0;
+        for (int i = 1; i <= steps; i++) {
+                float a = angle + sweep * i / steps;
+                int next = addVertex(mesh, cx + cosf(a) * radius, cy + sinf(a) * radius, color);
+                addTriangle(mesh, center, prev, next);
+
+                if (ring) {
+                        int next_outer = addVertex(mesh, cx + cosf(a) * outer, cy + sinf(a) * outer, clearColor(color));
+                        addTriangle(mesh, prev, prev_outer, next);
+                        addTriangle(mesh, next, prev_outer, next_outer);
+                        prev_outer = next_outer;
+                }
+                prev = next;
+        }
+
+        return 0;
+}
+
+static int addJoin(StrokeMesh *mesh, FlatPoint p, float nx0, float ny0, float nx1, float ny1, enum JoinStyle join, float fringe, SDL_Color color) {
+        float h = meshRadius(p.w, fringe);
+        float cross = nx0 * ny1 - ny0 * nx1;
+        float dot = nx0 * nx1 + ny0 * ny1;
+        if (fabsf(cross) < 1e-6f && dot > 0) {
+                return 0; // Straight through, the quads already meet
+        }
+
+        // The gap opens on the side the path turns away from
+        float s = (cross > 0) ? -1.0f : 1.0f;
+
+        if (join == JOIN_ROUND) {
+                return addArc(mesh, p.x, p.y, h, atan2f(s * ny0, s * nx0), atan2f(cross, dot), fringe, color);
+        }
+
+        if (reserveMesh(mesh, 4, 6) != 0) {
+                return 1;
+        }
+
+        int center = addVertex(mesh, p.x, p.y, color);
+        int a = addVertex(mesh, p.x + s * nx0 * h, p.y + s * ny0 * h, color);
+        int b = addVertex(mesh, p.x + s * nx1 * h, p.y + s * ny1 * h, color);
+
+        float mx = nx0 + nx1, my = ny0 + ny1;
+        float mlen = hypotf(mx, my);
+        float cos_half = (mlen > 1e-6f) ? (mx * nx0 + my * ny0) / mlen : 0.0f;
+
+        if (cos_half < 1.0f / MITER_LIMIT) {
+                addTriangle(mesh, center, a, b); // Bevel
+                if (fringe <= 0) {
+                        return 0;
+                }
+
+                // The bevel's fringe faces along the mitre direction; wedges meet the sides' fringes
+                float bx = s * mx / mlen, by = s * my / mlen;
+                return addFringe(mesh, a, b, bx, by, fringe, color)
+                        || addFringeWedge(mesh, a, s * nx0, s * ny0, bx, by, fringe, color)
+                        || addFringeWedge(mesh, b, bx, by, s * nx1, s * ny1, fringe, color);
+        }
+
+        float len = h / cos_half;
+        int m = addVertex(mesh, p.x + s * mx / mlen * len, p.y + s * my / mlen * len, color);
+        addTriangle(mesh, center, a, m);
+        addTriangle(mesh, center, m, b);
+        if (fringe <= 0) {
+                return 0;
+        }
+
+        return addFringe(mesh, a, m, s * nx0, s * ny0, fringe, color)
+                || addFringe(mesh, m, b, s * nx1, s * ny1, fringe, color)
+                || addFringeWedge(mesh, m, s * nx0, s * ny0, s * nx1, s * ny1, fringe, color);
+}
+
+static bool segmentVisible(FlatPoint a, FlatPoint b, SDL_FRect view) {
+        float pad = fmaxf(a.w, b.w);
+        return !(fmaxf(a.x, b.x) + pad < view.x || fminf(a.x, b.x) - pad > view.x + view.w ||
+                 fmaxf(a.y, b.y) + pad < view.y || fminf(a.y, b.y) - pad > view.y + view.h);
+}
+
+int TessellateStroke(const Polyline *line, enum JoinStyle join, SDL_Color color, SDL_FRect view, bool fringe, StrokeMesh *mesh) {
+        mesh->vertexCount = 0;
+        mesh->indexCount = 0;
+
+        float f = fringe ? STROKE_FRINGE : 0.0f;
+
+        if (line->count == 0) {
+                return 0;
+        }
+
+        const FlatPoint *p = line->points;
+
+        // Previous non-degenerate segment: its end point and unit normal
+        FlatPoint prev = p[0];
+        float pnx = 0, pny = 0;
+        bool has_prev = false, prev_visible = false;
+
+        for (uint32_t i = 1; i < line->count; i++) {
+                float dx = p[i].x - prev.x, dy = p[i].y - prev.y;
+                float len = hypotf(dx, dy);
+                if (len < 1e-3f) {
+                        continue;
+                }
+
+                float nx = -dy / len, ny = dx / len;
+                float ha = meshRadius(prev.w, f), hb = meshRadius(p[i].w, f);
+                bool visible = segmentVisible(prev, p[i], view);
+
+                if (visible || prev_visible) {
+                        int failed = has_prev
+                                ? addJoin(mesh, prev, pnx, pny, nx, ny, join, f, color)
+                                : addArc(mesh, prev.x, prev.y, ha, atan2f(ny, nx), (float) M_PI, f, color);
+                        if (failed) return 1;
+                }
+
+                if (visible) {
+                        if (reserveMesh(mesh, 4, 6) != 0) {
+                                return 1;
+                        }
+
+                        int v0 = addVertex(mesh, prev.x + nx * ha, prev.y + ny * ha, color);
+                        int v1 = addVertex(mesh, prev.x - nx * ha, prev.y - ny * ha, color);
+                        int v2 = addVertex(mesh, p[i].x + nx * hb, p[i].y + ny * hb, color);
+                        int v3 = addVertex(mesh, p[i].x - nx * hb, p[i].y - ny * hb, color);
+                        addTriangle(mesh, v0, v1, v2);
+                        addTriangle(mesh, v2, v1, v3);
+
+                        if (fringe && (addFringe(mesh, v0, v2, nx, ny, f, color) || addFringe(mesh, v1, v3, -nx, -ny, f, color))) {
+                                return 1;
+                        }
+                }
+
+                prev = p[i];
+                pnx = nx;
+                pny = ny;
+                has_prev = true;
+                prev_visible = visible;
+        }
+
+        if (!has_prev) {
+                // Single click: a dot
+                if (!segmentVisible(p[0], p[0], view)) return 0;
+                return addArc(mesh, p[0].x, p[0].y, meshRadius(p[0].w, f), 0, 2.0f * (float) M_PI, f, color);
+        }
+
+        if (prev_visible) {
+                return addArc(mesh, prev.x, prev.y, meshRadius(prev.w, f), atan2f(-pny, -pnx), (float) M_PI, f, color);
+        }
+
+        return 0;
+}
+
+void FreeStrokeMesh(StrokeMesh *mesh) {
+        free(mesh->vertices);
+        free(mesh->indices);
+        *mesh = (StrokeMesh) {0};
+}
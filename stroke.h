@@ -0,0 +1,50 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_render.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+#define STROKE_FRINGE 1.0f      // Width (px) of the band a fringed mesh fades out over
+
+enum JoinStyle: uint8_t {
+        JOIN_MITER,     // Falls back to bevel past MITER_LIMIT
+        JOIN_ROUND,
+};
+
+// Flattened stroke point in screen space, w is the full stroke width at that point
+typedef struct {
+        float x, y, w;
+} FlatPoint;
+
+typedef struct {
+        FlatPoint *points;
+        uint32_t count;
+        uint32_t capacity;
+} Polyline;
+
+// Indexed triangle list for one stroke, drawn with a single SDL_RenderGeometry
+typedef struct {
+        SDL_Vertex *vertices;
+        int *indices;
+        uint32_t vertexCount, vertexCapacity;
+        uint32_t indexCount, indexCapacity;
+} StrokeMesh;
+
+int pushPolylinePoint(Polyline *line, float x, float y, float w);
+void FreePolyline(Polyline *line);
+
+// Half width of the solid core of a stroke: the outer half pixel is left for an anti-aliased edge
+static inline float StrokeCoreRadius(float w) {
+        return (w > 1.0f) ? (w - 1.0f) * 0.5f : 0.0f;
+}
+
+// Builds segment quads, joins and round caps for `line`. Segments entirely outside
+// `view` are skipped. Returns 1 on allocation failure.
+// Without `fringe` the mesh is the stroke's whole outline, for a fill that works out edge
+// coverage itself. With it, the mesh is the stroke's core ringed by a STROKE_FRINGE wide band
+// whose outside vertices have alpha 0, so a renderer that can't anti-alias still gets soft edges.
+int TessellateStroke(const Polyline *line, enum JoinStyle join, SDL_Color color, SDL_FRect view, bool fringe, StrokeMesh *mesh);
+void FreeStrokeMesh(StrokeMesh *mesh);
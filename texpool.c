@@ -0,0 +1,92 @@
+#include "texpool.h"
+#include <SDL2/SDL_error.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void InitTexturePool(TexturePool *pool, SDL_Renderer *renderer, size_t cap) {
+        *pool = (TexturePool) { .renderer = renderer, .cap = cap };
+}
+
+static void removeIdle(TexturePool *pool, uint32_t i) {
+        pool->idleBytes -= pool->idle[i].bytes;
+        pool->idle[i] = pool->idle[--pool->idleCount];
+}
+
+SDL_Texture* AcquireTexture(TexturePool *pool, uint32_t format, int access, int width, int height) {
+        // Newest match first: it's the likeliest to still be resident
+        int best = -1;
+        for (uint32_t i = 0; i < pool->idleCount; i++) {
+                PooledTexture *t = &pool->idle[i];
+                if (t->format == format && t->access == access && t->width == width && t->height == height &&
+                    (best < 0 || t->released > pool->idle[best].released)) {
+                        best = (int) i;
+                }
+        }
+
+        if (best >= 0) {
+                SDL_Texture *texture = pool->idle[best].texture;
+                removeIdle(pool, (uint32_t) best);
+                pool->hits++;
+                return texture;
+        }
+
+        pool->misses++;
+        SDL_Texture *texture = SDL_CreateTexture(pool->renderer, format, access, width, height);
+        if (!texture) {
+                fprintf(stderr, "Failed to create texture: %s\n", SDL_GetError());
+        }
+        return texture;
+}
+
+void ReleaseTexture(TexturePool *pool, SDL_Texture *texture) {
+        if (!texture) {
+                return;
+        }
+
+        PooledTexture t = { .texture = texture, .released = ++pool->clock };
+        if (SDL_QueryTexture(texture, &t.format, &t.access, &t.width, &t.height) != 0) {
+                SDL_DestroyTexture(texture);
+                return;
+        }
+        t.bytes = (size_t) t.width * t.height * SDL_BYTESPERPIXEL(t.format);
+
+        if (t.bytes > pool->cap) {
+                SDL_DestroyTexture(texture);
+                return;
+        }
+
+        // Make room, least recently released first
+        while (pool->idleBytes + t.bytes > pool->cap) {
+                uint32_t oldest = 0;
+                for (uint32_t i = 1; i < pool->idleCount; i++) {
+                        if (pool->idle[i].released < pool->idle[oldest].released) oldest = i;
+                }
+                SDL_DestroyTexture(pool->idle[oldest].texture);
+                removeIdle(pool, oldest);
+                pool->evictions++;
+        }
+
+        if (pool->idleCount >= pool->idleCapacity) {
+                uint32_t new_capacity = (pool->idleCapacity == 0) ? 8 : pool->idleCapacity << 1;
+
+                PooledTexture *temp = realloc(pool->idle, new_capacity * sizeof(PooledTexture));
+                if (!temp) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        SDL_DestroyTexture(texture);
+                        return;
+                }
+                pool->idle = temp;
+                pool->idleCapacity = new_capacity;
+        }
+
+        pool->idle[pool->idleCount++] = t;
+        pool->idleBytes += t.bytes;
+}
+
+void FreeTexturePool(TexturePool *pool) {
+        for (uint32_t i = 0; i < pool->idleCount; i++) {
+                SDL_DestroyTexture(pool->idle[i].texture);
+        }
+        free(pool->idle);
+        *pool = (TexturePool) {0};
+}
@@ -0,0 +1,38 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_render.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#pragma once
+
+#define TEXTURE_POOL_CAP ((size_t) 64 << 20)   // Default bytes of idle textures kept for reuse
+
+// An idle texture waiting to be handed out again
+typedef struct {
+        SDL_Texture *texture;
+        uint32_t format;
+        int access, width, height;
+        size_t bytes;
+        uint64_t released;      // Pool clock when it was released, for LRU eviction
+} PooledTexture;
+
+// Recycles textures by size, format and access instead of going back to the driver. Only
+// idle textures count against `cap`; past it the least recently released go first.
+// A recycled texture keeps its old pixels and blend mode.
+typedef struct {
+        SDL_Renderer *renderer;
+        PooledTexture *idle;
+        uint32_t idleCount, idleCapacity;
+        size_t idleBytes, cap;
+        uint64_t clock;
+
+        uint32_t hits, misses, evictions;
+} TexturePool;
+
+void InitTexturePool(TexturePool *pool, SDL_Renderer *renderer, size_t cap);
+// An idle texture of this kind, or a new one. NULL when creation fails.
+SDL_Texture* AcquireTexture(TexturePool *pool, uint32_t format, int access, int width, int height);
+// Gives a texture from AcquireTexture (or anywhere on this renderer) back for reuse
+void ReleaseTexture(TexturePool *pool, SDL_Texture *texture);
+void FreeTexturePool(TexturePool *pool);
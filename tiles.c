@@ -0,0 +1,206 @@
+#include "tiles.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int ResizeTileGrid(TileGrid *grid, int width, int height) {
+        int old_width = grid->width, old_height = grid->height;
+        int columns = (width + TILE_SIZE - 1) / TILE_SIZE;
+        int rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+        if (columns * rows != grid->columns * grid->rows || grid->dirty == NULL) {
+                size_t tiles = (size_t) (columns * rows > 0 ? columns * rows : 1);
+
+                uint8_t *dirty = realloc(grid->dirty, tiles);
+                if (dirty) grid->dirty = dirty;
+                TileJob *jobs = realloc(grid->jobs, tiles * sizeof(TileJob));
+                if (jobs) grid->jobs = jobs;
+                SDL_Rect *runs = realloc(grid->runs, tiles * sizeof(SDL_Rect));
+                if (runs) grid->runs = runs;
+
+                if (!dirty || !jobs || !runs) {
+                        fprintf(stderr, "Memory allocation failed!\n");
+                        return 1;
+                }
+        }
+
+        grid->columns = columns;
+        grid->rows = rows;
+        grid->width = width;
+        grid->height = height;
+
+        // Tile indices have moved, but nothing is left dirty between redraws
+        memset(grid->dirty, 0, (size_t) (columns * rows));
+        grid->dirtyCount = 0;
+        MarkTilesDirty(grid, (SDL_Rect) { old_width, 0, width - old_width, height });
+        MarkTilesDirty(grid, (SDL_Rect) { 0, old_height, width, height - old_height });
+
+        return 0;
+}
+
+void MarkTilesDirty(TileGrid *grid, SDL_Rect area) {
+        SDL_Rect full = { 0, 0, grid->width, grid->height };
+        if (!SDL_IntersectRect(&area, &full, &area)) {
+                return;
+        }
+
+        int c0 = area.x / TILE_SIZE, c1 = (area.x + area.w - 1) / TILE_SIZE;
+        int r0 = area.y / TILE_SIZE, r1 = (area.y + area.h - 1) / TILE_SIZE;
+
+        for (int r = r0; r <= r1; r++) {
+                for (int c = c0; c <= c1; c++) {
+                        uint8_t *flag = &grid->dirty[r * grid->columns + c];
+                        grid->dirtyCount += !*flag;
+                        *flag = 1;
+                }
+        }
+}
+
+void MarkAllTilesDirty(TileGrid *grid) {
+        memset(grid->dirty, 1, (size_t) (grid->columns * grid->rows));
+        grid->dirtyCount = grid->columns * grid->rows;
+}
+
+SDL_Rect TileRect(TileGrid *grid, int column, int row) {
+        SDL_Rect rect = { column * TILE_SIZE, row * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+        if (rect.x + rect.w > grid->width) rect.w = grid->width - rect.x;
+        if (rect.y + rect.h > grid->height) rect.h = grid->height - rect.y;
+        return rect;
+}
+
+void RasterizeRect(RasterBuffer *RB, SDL_Renderer *renderer, LinesArray *PA, SDL_Rect rect, uint32_t start, uint32_t end, Pan pan, SDL_Color background, SDL_Color color) {
+        ClearRasterRect(RB, rect, background);
+
+        set_raster_target(RB);
+        SetRasterClip(RB, &rect);
+        RenderVisibleLines(renderer, PA, pan, start, end, color);
+        SetRasterClip(RB, NULL);
+        set_raster_target(NULL);
+}
+
+int ScrollAndFill(RasterBuffer *RB, SDL_Renderer *renderer, LinesArray *PA, Pan old_pan, Pan pan, SDL_Color background, SDL_Color color) {
+        double dx = pan.x - old_pan.x, dy = pan.y - old_pan.y;
+        if (dx != floor(dx) || dy != floor(dy) || fabs(dx) >= RB->width || fabs(dy) >= RB->height) {
+                return 1;
+        }
+
+        int ix = (int) dx, iy = (int) dy;
+        if (ix == 0 && iy == 0) {
+                return 0;
+        }
+
+        ScrollRasterBuffer(RB, ix, iy);
+
+        uint32_t end = (PA->points.count != 0) ? PA->points.count - 1 : 0;
+        if (ix != 0) {
+                SDL_Rect strip = { (ix > 0) ? 0 : RB->width + ix, 0, abs(ix), RB->height };
+                RasterizeRect(RB, renderer, PA, strip, 0, end, pan, background, color);
+        }
+        if (iy != 0) {
+                SDL_Rect strip = { 0, (iy > 0) ? 0 : RB->height + iy, RB->width, abs(iy) };
+                RasterizeRect(RB, renderer, PA, strip, 0, end, pan, background, color);
+        }
+
+        return 0;
+}
+
+static void rasterizeTileJob(void *arg) {
+        TileJob *job = arg;
+
+        ClearRasterRect(&job->target, job->rect, job->background);
+        SetRasterClip(&job->target, &job->rect);
+
+        set_raster_target(&job->target);
+        RenderStrokeIds(job->renderer, job->PA, job->pan, job->ids, job->idCount, job->start, job->end, job->color);
+        set_raster_target(NULL);
+}
+
+uint32_t RedrawDirtyTiles(TileGrid *grid, RasterBuffer *RB, SDL_Renderer *renderer, LinesArray *PA, uint32_t start, uint32_t end, Pan pan, SDL_Color background, SDL_Color color) {
+        if (grid->dirtyCount == 0) {
+                return 0;
+        }
+
+        bool parallel = grid->pool != NULL && grid->pool->threadCount > 0;
+        uint32_t runCount = 0, jobCount = 0, redrawn = 0;
+        SDL_Rect area = {0};
+
+        for (int r = 0; r < grid->rows; r++) {
+                int c = 0;
+                while (c < grid->columns) {
+                        if (!grid->dirty[r * grid->columns + c]) {
+                                c++;
+                                continue;
+                        }
+
+                        // Extend over the run of dirty tiles in this row
+                        int run = c;
+                        while (run < grid->columns && grid->dirty[r * grid->columns + run]) {
+                                grid->dirty[r * grid->columns + run] = 0;
+                                run++;
+                        }
+
+                        SDL_Rect rect = TileRect(grid, c, r);
+                        SDL_Rect last = TileRect(grid, run - 1, r);
+                        rect.w = last.x + last.w - rect.x;
+
+                        grid->runs[runCount++] = rect;
+                        if (runCount == 1) {
+                                area = rect;
+                        } else {
+                                SDL_UnionRect(&area, &rect, &area);
+                        }
+
+                        // Serially a whole run is one job; in parallel every tile is, to spread the load
+                        for (int t = c; t < run; t += parallel ? 1 : run - c) {
+                                grid->jobs[jobCount++] = (TileJob) {
+                                        .target = *RB,
+                                        .rect = parallel ? TileRect(grid, t, r) : rect,
+                                };
+                        }
+
+                        redrawn += run - c;
+                        c = run;
+                }
+        }
+
+        // One index query for everything, on this thread; jobs only cull against it
+        const uint32_t *ids;
+        Bounds world = { area.x - pan.x, area.y - pan.y, area.x + area.w - pan.x, area.y + area.h - pan.y };
+        uint32_t idCount = QueryStrokes(PA, world, &ids);
+
+        for (uint32_t i = 0; i < jobCount; i++) {
+                TileJob *job = &grid->jobs[i];
+                job->renderer = renderer;
+                job->PA = PA;
+                job->ids = ids;
+                job->idCount = idCount;
+                job->start = start;
+                job->end = end;
+                job->pan = pan;
+                job->background = background;
+                job->color = color;
+        }
+        RunJobs(grid->pool, rasterizeTileJob, grid->jobs, sizeof(TileJob), jobCount);
+
+        // Cheap combine: upload and copy each run
+        for (uint32_t i = 0; i < runCount; i++) {
+                UploadRasterRect(RB, grid->runs[i]);
+                SDL_RenderCopy(renderer, RB->texture, &grid->runs[i], &grid->runs[i]);
+        }
+
+        if (PA->points.count != 0) {
+                PA->rendered_till = PA->points.count - 1;
+        }
+        grid->dirtyCount = 0;
+
+        return redrawn;
+}
+
+void FreeTileGrid(TileGrid *grid) {
+        free(grid->dirty);
+        free(grid->jobs);
+        free(grid->runs);
+        *grid = (TileGrid) {0};
+}
@@ -0,0 +1,59 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_render.h>
+#include <stdint.h>
+
+#include "point.h"
+#include "raster.h"
+#include "workers.h"
+
+#pragma once
+
+#define TILE_SIZE 128
+
+// One tile (or run of tiles) to rasterize, possibly on a worker thread
+typedef struct {
+        RasterBuffer target;    // Shares the canvas pixels, clipped to rect
+        SDL_Rect rect;
+        SDL_Renderer *renderer;
+        LinesArray *PA;
+        const uint32_t *ids;    // Strokes under all dirty tiles
+        uint32_t idCount;
+        uint32_t start, end;
+        Pan pan;
+        SDL_Color background, color;
+} TileJob;
+
+// Fixed grid of TILE_SIZE squares over the draw layer; only dirty tiles are
+// re-rasterized and re-uploaded.
+typedef struct {
+        uint8_t *dirty;         // columns * rows flags
+        int columns, rows;
+        int width, height;      // Pixel area the grid covers
+        uint32_t dirtyCount;
+
+        WorkerPool *pool;       // Optional: tiles are rasterized in parallel when set
+        TileJob *jobs;          // columns * rows scratch
+        SDL_Rect *runs;         // columns * rows scratch
+} TileGrid;
+
+// Marks the tiles the old size didn't cover dirty (all of them the first time), to go with
+// ResizeRasterBuffer keeping the rest. Returns 1 on allocation failure.
+int ResizeTileGrid(TileGrid *grid, int width, int height);
+void MarkTilesDirty(TileGrid *grid, SDL_Rect area);
+void MarkAllTilesDirty(TileGrid *grid);
+SDL_Rect TileRect(TileGrid *grid, int column, int row);
+
+// Clears `rect` of RB to `background` and rasterizes points [start, end] into it
+void RasterizeRect(RasterBuffer *RB, SDL_Renderer *renderer, LinesArray *PA, SDL_Rect rect, uint32_t start, uint32_t end, Pan pan, SDL_Color background, SDL_Color color);
+
+// Pans RB, which holds the whole document rendered at `old_pan`, to `pan`: the pixels are
+// scrolled by the integer delta and only the exposed strips are rasterized. Returns 1 when
+// that is not possible (sub-pixel delta, or nothing left to reuse) and a full redraw is needed.
+int ScrollAndFill(RasterBuffer *RB, SDL_Renderer *renderer, LinesArray *PA, Pan old_pan, Pan pan, SDL_Color background, SDL_Color color);
+
+// Clears every dirty tile of RB to `background`, rasterizes points [start, end] into it,
+// uploads it and copies it into the current render target. Neighbouring dirty tiles in a
+// row are handled as one rect. Returns the number of tiles redrawn.
+uint32_t RedrawDirtyTiles(TileGrid *grid, RasterBuffer *RB, SDL_Renderer *renderer, LinesArray *PA, uint32_t start, uint32_t end, Pan pan, SDL_Color background, SDL_Color color);
+void FreeTileGrid(TileGrid *grid);
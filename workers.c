@@ -0,0 +1,117 @@
+#include "workers.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "point.h"
+
+// Takes jobs until the batch is drained. Called with the lock held, returns with it held.
+static void drainJobs(WorkerPool *pool) {
+        while (pool->nextJob < pool->jobCount) {
+                uint32_t job = pool->nextJob++;
+                JobFn fn = pool->fn;
+                void *arg = pool->args + job * pool->argSize;
+
+                pthread_mutex_unlock(&pool->lock);
+                fn(arg);
+                pthread_mutex_lock(&pool->lock);
+
+                if (++pool->finished == pool->jobCount) {
+                        pthread_cond_broadcast(&pool->idle);
+                }
+        }
+}
+
+static void* workerMain(void *data) {
+        WorkerPool *pool = data;
+        uint64_t seen = 0;
+
+        pthread_mutex_lock(&pool->lock);
+        while (true) {
+                while (!pool->quit && pool->batch == seen) {
+                        pthread_cond_wait(&pool->wake, &pool->lock);
+                }
+                if (pool->quit) break;
+
+                seen = pool->batch;
+                drainJobs(pool);
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        FreeStrokeScratch(); // Thread local
+        return NULL;
+}
+
+int CreateWorkerPool(WorkerPool *pool, int threads) {
+        *pool = (WorkerPool) {0};
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->wake, NULL);
+        pthread_cond_init(&pool->idle, NULL);
+
+        if (threads <= 0) {
+                return 0;
+        }
+
+        pool->threads = malloc(threads * sizeof(pthread_t));
+        if (!pool->threads) {
+                fprintf(stderr, "Memory allocation failed!\n");
+                return 1;
+        }
+
+        for (int i = 0; i < threads; i++) {
+                if (pthread_create(&pool->threads[i], NULL, workerMain, pool) != 0) {
+                        fprintf(stderr, "Failed to create worker thread\n");
+                        break;
+                }
+                pool->threadCount++;
+        }
+
+        return 0;
+}
+
+void RunJobs(WorkerPool *pool, JobFn fn, void *args, size_t arg_size, uint32_t count) {
+        if (count == 0) {
+                return;
+        }
+
+        if (pool == NULL || pool->threadCount == 0 || count == 1) {
+                for (uint32_t i = 0; i < count; i++) {
+                        fn((char *) args + i * arg_size);
+                }
+                return;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->fn = fn;
+        pool->args = args;
+        pool->argSize = arg_size;
+        pool->jobCount = count;
+        pool->nextJob = 0;
+        pool->finished = 0;
+        pool->batch++;
+        pthread_cond_broadcast(&pool->wake);
+
+        drainJobs(pool);
+        while (pool->finished < pool->jobCount) {
+                pthread_cond_wait(&pool->idle, &pool->lock);
+        }
+        pool->jobCount = 0;
+        pool->nextJob = 0;
+        pthread_mutex_unlock(&pool->lock);
+}
+
+void FreeWorkerPool(WorkerPool *pool) {
+        pthread_mutex_lock(&pool->lock);
+        pool->quit = true;
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (int i = 0; i < pool->threadCount; i++) {
+                pthread_join(pool->threads[i], NULL);
+        }
+        free(pool->threads);
+
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->wake);
+        pthread_cond_destroy(&pool->idle);
+        *pool = (WorkerPool) {0};
+}
@@ -0,0 +1,31 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#pragma once
+
+typedef void (*JobFn)(void *arg);
+
+// Fixed set of threads that run batches of independent jobs. The calling thread
+// works on the batch too, so a pool of N threads uses N + 1 cores.
+typedef struct {
+        pthread_t *threads;
+        int threadCount;
+
+        pthread_mutex_t lock;
+        pthread_cond_t wake;    // New batch or quit
+        pthread_cond_t idle;    // A batch finished
+
+        JobFn fn;
+        char *args;             // jobCount * argSize bytes
+        size_t argSize;
+        uint32_t jobCount, nextJob, finished;
+        uint64_t batch;
+        bool quit;
+} WorkerPool;
+
+int CreateWorkerPool(WorkerPool *pool, int threads);
+// Runs fn(&args[i]) for every job and returns once all have finished
+void RunJobs(WorkerPool *pool, JobFn fn, void *args, size_t arg_size, uint32_t count);
+void FreeWorkerPool(WorkerPool *pool);